@@ -5,6 +5,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 namespace mymuduo {
 
@@ -26,19 +27,71 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
     acceptSocket_.setReusePort(reuseport);
     acceptSocket_.bindAddress(listenAddr);
     acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
+    acceptChannel_.setPriority(kHighPriority);
+}
+
+// 从其它进程收到的 fd 不一定是非阻塞的
+static int setNonblocking(int sockfd) {
+    int flags = ::fcntl(sockfd, F_GETFL, 0);
+    if(flags < 0 || ::fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        LOG_ERROR << "set O_NONBLOCK on listen socket " << sockfd << " err : " << errno;
+    }
+    ::fcntl(sockfd, F_SETFD, FD_CLOEXEC);
+    return sockfd;
+}
+
+Acceptor::Acceptor(EventLoop *loop, int listenfd)
+    : loop_(loop),
+      acceptSocket_(setNonblocking(listenfd)),
+      acceptChannel_(loop, acceptSocket_.fd()),
+      listening_(false) {
+
+    acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
+    acceptChannel_.setPriority(kHighPriority);
 }
 
 Acceptor::~Acceptor() {
-    acceptChannel_.disableAll();
-    acceptChannel_.remove();
+    if(listening_) {
+        acceptChannel_.disableAll();
+        acceptChannel_.remove();
+    }
 }
 
 void Acceptor::listen() {
     listening_ = true;
-    acceptSocket_.listen();
+    if(listenOptions_.deferAcceptSeconds > 0) {
+        // 三次握手完成后不立即唤醒 mainLoop，等客户端发来数据（或超时）以后 accept 才返回
+        acceptSocket_.setTcpDeferAccept(listenOptions_.deferAcceptSeconds);
+    }
+    if(listenOptions_.fastOpenQueueLen > 0) {
+        // 客户端带 cookie 的 SYN 可以携带请求数据，省掉一个 RTT
+        acceptSocket_.setTcpFastOpen(listenOptions_.fastOpenQueueLen);
+    }
+    acceptSocket_.listen(listenOptions_.backlog);
     acceptChannel_.enableReading();
 }
 
+void Acceptor::stopListening() {
+    if(!listening_) {
+        return ;
+    }
+    listening_ = false;
+    acceptChannel_.disableAll();
+    acceptChannel_.remove();
+
+    // 监听 socket 是非阻塞的，accept 到 EAGAIN 为止
+    InetAddress peerAddr;
+    int connfd;
+    while((connfd = acceptSocket_.accept(&peerAddr)) >= 0) {
+        if(newConnectionCallback_) {
+            newConnectionCallback_(connfd, peerAddr);
+        } else {
+            ::close(connfd);
+        }
+    }
+    acceptSocket_.close();
+}
+
 // listenfd 有事件发生时（也就是有新用户连接了）就会调用 handleRead
 void Acceptor::handleRead() {
     InetAddress peerAddr;
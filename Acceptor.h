@@ -4,6 +4,7 @@
 #include <functional>
 #include "Socket.h"
 #include "Channel.h"
+#include "SocketOptions.h"
 
 #include "noncopyable.h"
 
@@ -18,14 +19,32 @@ public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
 
     Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
+    /**
+     * 接管一个已经 bind（可能已经 listen）的监听 socket，如热重启时从旧进程收到的 fd
+     * listen() 时会再调用一次 ::listen，对已经在监听的 socket 只会更新 backlog
+    */
+    Acceptor(EventLoop *loop, int listenfd);
     ~Acceptor();
 
     void setNewConnectionCallback(const NewConnectionCallback &cb) {
         newConnectionCallback_ = cb;
     }
 
+    // 需要在 listen 之前设置
+    void setListenOptions(const ListenOptions &options) {
+        listenOptions_ = options;
+    }
+
     bool listening() const { return listening_; }
+    // 监听 socket 的 fd，可以交给其它进程（热重启），stopListening 之后为 -1
+    int listenFd() const { return acceptSocket_.fd(); }
     void listen();
+    /**
+     * 停止监听：先把已经完成握手、还在 accept 队列中的连接全部 accept 出来交给 newConnectionCallback_，
+     * 然后关闭监听 socket 的 fd；没有其它进程共享这个 socket 时，之后新的连接请求会被内核直接拒绝，
+     * 热重启时 socket 已经交给了新进程，关闭 fd 不影响新进程继续 accept；需要在 loop 线程中调用
+    */
+    void stopListening();
 
 private:
     void handleRead();
@@ -35,6 +54,7 @@ private:
     Socket acceptSocket_;
     Channel acceptChannel_;
     NewConnectionCallback newConnectionCallback_;
+    ListenOptions listenOptions_;
     bool listening_;
 };
 
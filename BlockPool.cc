@@ -0,0 +1,56 @@
+#include "BlockPool.h"
+
+#include <new>
+
+namespace mymuduo {
+
+BlockPool::BlockPool(size_t maxCached)
+    : blockSize_(0),
+      freeList_(nullptr),
+      cached_(0),
+      maxCached_(maxCached) {}
+
+BlockPool::~BlockPool() {
+    while(freeList_) {
+        Node *node = freeList_;
+        freeList_ = node->next;
+        ::operator delete(node);
+    }
+}
+
+void *BlockPool::allocate(size_t size) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(blockSize_ == 0 && size >= sizeof(Node)) {
+            blockSize_ = size;
+        }
+        if(size == blockSize_ && freeList_) {
+            Node *node = freeList_;
+            freeList_ = node->next;
+            --cached_;
+            return node;
+        }
+    }
+    return ::operator new(size);
+}
+
+void BlockPool::deallocate(void *p, size_t size) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(size == blockSize_ && cached_ < maxCached_) {
+            Node *node = static_cast<Node *>(p);
+            node->next = freeList_;
+            freeList_ = node;
+            ++cached_;
+            return ;
+        }
+    }
+    ::operator delete(p);
+}
+
+size_t BlockPool::cached() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cached_;
+}
+
+}   // namespace mymuduo
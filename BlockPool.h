@@ -0,0 +1,77 @@
+#ifndef _BLOCKPOOL_H
+#define _BLOCKPOOL_H
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <mutex>
+#include <cstddef>
+
+namespace mymuduo {
+
+/**
+ * 定长内存块池：块的大小在第一次分配时确定，释放的块挂在空闲链表上，下次分配直接复用
+ * 大小不一致的请求直接交给 operator new / delete，空闲链表最多缓存 maxCached 个块
+ * 一般由 mainLoop 分配、由 subLoop 释放，所以用一把锁保护，临界区只有几次指针操作
+*/
+class BlockPool : noncopyable {
+public:
+    static const size_t kDefaultMaxCached = 4096;
+
+    explicit BlockPool(size_t maxCached = kDefaultMaxCached);
+    ~BlockPool();
+
+    void *allocate(size_t size);
+    void deallocate(void *p, size_t size);
+
+    // 空闲链表上缓存的块数
+    size_t cached() const;
+
+private:
+    struct Node {
+        Node *next;
+    };
+
+    mutable std::mutex mutex_;
+    size_t blockSize_;      // 0 表示还没有分配过
+    Node *freeList_;
+    size_t cached_;
+    const size_t maxCached_;
+};
+
+/**
+ * 从 BlockPool 分配内存的分配器，配合 std::allocate_shared 使用：
+ * 对象和 shared_ptr 的控制块在同一个块中，控制块里保存的分配器副本持有 pool，对象释放之前 pool 不会析构
+*/
+template<typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(const std::shared_ptr<BlockPool> &pool) : pool_(pool) {}
+
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U> &other) : pool_(other.pool_) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(pool_->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *p, size_t n) {
+        pool_->deallocate(p, n * sizeof(T));
+    }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U> &rhs) const { return pool_ == rhs.pool_; }
+    template<typename U>
+    bool operator!=(const PoolAllocator<U> &rhs) const { return pool_ != rhs.pool_; }
+
+private:
+    template<typename U> friend class PoolAllocator;
+
+    std::shared_ptr<BlockPool> pool_;
+};
+
+}   // namespace mymuduo
+
+#endif
@@ -1,28 +1,32 @@
 #include "Buffer.h"
 
 #include <errno.h>
+#include <algorithm>
 #include <sys/uio.h>
 #include <unistd.h>
 
 namespace mymuduo {
 
+const char Buffer::kCRLF[] = "\r\n";
+
 /**
  * 从 fd 上读取数据（Poller 工作在 LT 模式）
  * Buffer 缓冲区是有大小的，但是从 fd 上读数据时却不知道 tcp 数据最终的大小
 */
-ssize_t Buffer::readFd(int fd, int *saveErrno) {
-    char extrabuf[65536] = {0};     // 栈上内存空间 64K
+ssize_t Buffer::readFd(int fd, int *saveErrno, size_t maxBytes) {
+    char extrabuf[65536];           // 栈上内存空间 64K，readv 会覆盖它，不需要清零
 
     struct iovec vec[2];
 
     const size_t writable = writeableBytes();   // Buffer 缓冲区剩余可写大小
     vec[0].iov_base = begin() + writerIndex_;
-    vec[0].iov_len = writable;
+    vec[0].iov_len = std::min(writable, maxBytes);
 
+    // 一次最多读取 maxBytes 字节，剩下的部分才用 extrabuf
     vec[1].iov_base = extrabuf;
-    vec[1].iov_len = sizeof(extrabuf);
+    vec[1].iov_len = std::min(sizeof(extrabuf), maxBytes - vec[0].iov_len);
 
-    const int iovcnt = (writable < sizeof(extrabuf)) ? 2 : 1;
+    const int iovcnt = (writable < sizeof(extrabuf) && vec[1].iov_len > 0) ? 2 : 1;
     const ssize_t n = ::readv(fd, vec, iovcnt);
 
     if(n < 0) {
@@ -30,13 +34,27 @@ ssize_t Buffer::readFd(int fd, int *saveErrno) {
     } else if(n <= writable) {      // Buffer 足够存储要读的数据
         writerIndex_ += n;
     } else {    // extrabuf 中也写入了数据
-        writerIndex_ = buffer_.size();
+        writerIndex_ = capacity_;
         append(extrabuf, n - writable);     // 把 extrabuf 中的数据写到 Buffer 缓冲区中
     }
 
     return n;
 }
 
+/**
+ * 容量按 2 倍增长，摊还下来每个字节只会被搬移常数次
+ * realloc 在原地就能扩展时不会发生拷贝，且新增的空间不会被初始化
+*/
+void Buffer::grow(size_t size) {
+    size_t newCapacity = std::max(capacity_ * 2, size);
+    char *p = static_cast<char *>(::realloc(buffer_, newCapacity));
+    if(p == nullptr) {
+        throw std::bad_alloc();
+    }
+    buffer_ = p;
+    capacity_ = newCapacity;
+}
+
 ssize_t Buffer::writeFd(int fd, int *saveErrno) {
     ssize_t n = ::write(fd, peek(), readableBytes());
     if(n < 0) {
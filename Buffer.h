@@ -1,11 +1,16 @@
 #ifndef _BUFFER_H
 #define _BUFFER_H
 
-#include <vector>
 #include <string>
 #include <algorithm>
+#include <new>
 #include <arpa/inet.h>
 #include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "StringSearch.h"
+#include "StringPiece.h"
 
 namespace mymuduo {
 
@@ -18,17 +23,57 @@ public:
     static const size_t kInitialSize = 1024;
 
     explicit Buffer(size_t initalSize = kInitialSize)
-        : buffer_(kCheapPrepend + initalSize),
+        : buffer_(allocate(kCheapPrepend + initalSize)),
+          capacity_(kCheapPrepend + initalSize),
           readerIndex_(kCheapPrepend),
           writerIndex_(kCheapPrepend)
     {}
 
+    Buffer(const Buffer &rhs)
+        : buffer_(allocate(rhs.capacity_)),
+          capacity_(rhs.capacity_),
+          readerIndex_(rhs.readerIndex_),
+          writerIndex_(rhs.writerIndex_)
+    {
+        // 只拷贝已经写入过的区域，后面的可写区域不需要初始化
+        if(rhs.buffer_ != nullptr) {
+            ::memcpy(buffer_, rhs.buffer_, writerIndex_);
+        }
+    }
+
+    // 直接接管 rhs 的内存；rhs 变成不持有内存的空 Buffer，仍然可以继续使用，第一次写入时再分配
+    Buffer(Buffer &&rhs) noexcept
+        : buffer_(rhs.buffer_),
+          capacity_(rhs.capacity_),
+          readerIndex_(rhs.readerIndex_),
+          writerIndex_(rhs.writerIndex_)
+    {
+        rhs.buffer_ = nullptr;
+        rhs.capacity_ = rhs.readerIndex_ = rhs.writerIndex_ = kCheapPrepend;
+    }
+
+    Buffer &operator=(Buffer rhs) {
+        swap(rhs);
+        return *this;
+    }
+
+    ~Buffer() {
+        ::free(buffer_);
+    }
+
+    void swap(Buffer &rhs) {
+        std::swap(buffer_, rhs.buffer_);
+        std::swap(capacity_, rhs.capacity_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+    }
+
     size_t readableBytes() const {
         return writerIndex_ - readerIndex_;
     }
 
     size_t writeableBytes() const {
-        return buffer_.size() - writerIndex_;
+        return capacity_ - writerIndex_;
     }
 
     size_t prependableBytes() const {
@@ -40,6 +85,39 @@ public:
         return begin() + readerIndex_;
     }
 
+    // 可读区域的只读视图，不拷贝数据，在下一次 retrieve / append / readFd 之前有效
+    StringPiece toStringPiece() const {
+        return StringPiece(peek(), readableBytes());
+    }
+
+    /**
+     * 在可读区域中查找，返回第一个匹配的地址，找不到返回 nullptr
+     * offset 是相对 peek() 的起始偏移：上次没找到时记下已经扫描过的长度，下次从这里继续，
+     * 不必每次 handleRead 都从头扫描不完整的消息（多字节分隔符要回退 len - 1 个字节）
+    */
+    const char *findByte(char c, size_t offset = 0) const {
+        if(offset >= readableBytes()) {
+            return nullptr;
+        }
+        return search::findByte(peek() + offset, beginWirte(), c);
+    }
+
+    const char *findSequence(const char *seq, size_t len, size_t offset = 0) const {
+        if(offset >= readableBytes()) {
+            return nullptr;
+        }
+        return search::findSequence(peek() + offset, beginWirte(), seq, len);
+    }
+
+    const char *findCRLF(size_t offset = 0) const {
+        return findSequence(kCRLF, 2, offset);
+    }
+
+    const char *findEOL(size_t offset = 0) const {
+        return findByte('\n', offset);
+    }
+
+    // 可读数据不足 4 个字节时返回 0，调用方应先检查 readableBytes()
     int32_t peekInt32() const {
         if(readableBytes() >= sizeof(int32_t)) {
             int32_t nw32 = 0;
@@ -47,6 +125,7 @@ public:
             int32_t host32 = ntohl(nw32);
             return host32;
         }
+        return 0;
     }
 
     void hasWritten(size_t len) {
@@ -74,6 +153,11 @@ public:
         return retrieveAsString(readableBytes());
     }
 
+    // 取走 [peek(), end) 的数据，end 一般是 findCRLF / findEOL 的返回值
+    void retrieveUntil(const char *end) {
+        retrieve(end - peek());
+    }
+
     std::string retrieveAsString(size_t len) {
         std::string result(peek(), len);
         retrieve(len);      // 上面一句把缓冲区中可读的数据已经读取出来，这里肯定要对缓冲区进行复位操作
@@ -105,6 +189,9 @@ public:
     }
 
     void prepend(const void *data, size_t len) {
+        if(buffer_ == nullptr) {    // 被移动过的 Buffer，先把预留区分配出来
+            grow(capacity_);
+        }
         if(len <= prependableBytes()) {
             readerIndex_ -= len;
             const char *d = (const char *)data;
@@ -121,19 +208,25 @@ public:
     }
 
     // 从 fd 上读取数据
-    ssize_t readFd(int fd, int *saveErrno);
+    ssize_t readFd(int fd, int *saveErrno, size_t maxBytes = SIZE_MAX);
     // 通过 fd 发生数据
     ssize_t writeFd(int fd, int *saveErrno);
 
 private:
     char *begin() {
-        // vector 底层数组元素的地址，也就是数组的首地址
-        return &*buffer_.begin();
+        return buffer_;
     }
 
     const char *begin() const {
-        // vector 底层数组元素的地址，也就是数组的首地址
-        return &*buffer_.begin();
+        return buffer_;
+    }
+
+    static char *allocate(size_t size) {
+        char *p = static_cast<char *>(::malloc(size));
+        if(p == nullptr) {
+            throw std::bad_alloc();
+        }
+        return p;
     }
 
     /**
@@ -144,7 +237,7 @@ private:
     void makeSpace(size_t len) {
         // 可写大小 + 空闲大小 < 要写大小 + 空闲大小(默认 8 字节)
         if(writeableBytes() + prependableBytes() < len + kCheapPrepend) {
-            buffer_.resize(writerIndex_ + len);
+            grow(writerIndex_ + len);
         } else {
             size_t readable = readableBytes();
             std::copy(begin() + readerIndex_, begin() + writerIndex_, begin() + kCheapPrepend);
@@ -153,7 +246,14 @@ private:
         }
     }
 
-    std::vector <char> buffer_;
+    static const char kCRLF[];
+
+    // 扩容到至少 size 字节，新增的空间不做初始化（之后的 readv / append 会覆盖它）
+    void grow(size_t size);
+
+    // 用 malloc / realloc 管理的原始内存，避免 vector::resize 对新空间逐字节清零
+    char *buffer_;
+    size_t capacity_;
     size_t readerIndex_;
     size_t writerIndex_;
 };
@@ -0,0 +1,141 @@
+#ifndef _BUFFERREADER_H
+#define _BUFFERREADER_H
+
+#include "Buffer.h"
+#include "ByteOrder.h"
+#include "StringPiece.h"
+
+namespace mymuduo {
+
+/**
+ * 从 Buffer 的可读区域解析二进制数据，所有读操作都做边界检查
+ * 读取只移动 reader 自己的位置，不修改 Buffer；解析完一条完整的消息后调用 commit 从 Buffer 中取走，
+ * 数据不够时（返回 false）直接放弃这个 reader，等更多的数据到来后重新解析；
+ * 但如果 malformed() 为 true，说明数据本身是错的，再等也解析不出来，调用方应该关闭连接
+*/
+class BufferReader {
+public:
+    explicit BufferReader(Buffer *buf)
+        : buf_(buf), pos_(0), ok_(true), malformed_(false) {}
+
+    // 所有读取都成功时为 true，任意一次失败后一直为 false
+    bool ok() const { return ok_; }
+    // 读到了格式错误的数据（而不是数据不够），一旦为 true 就一直为 true
+    bool malformed() const { return malformed_; }
+    // 已经读取的字节数
+    size_t position() const { return pos_; }
+    size_t remaining() const { return buf_->readableBytes() - pos_; }
+
+    template <typename T>
+    bool readBE(T *v) {
+        if(!require(sizeof(T))) {
+            return false;
+        }
+        *v = endian::loadBE<T>(buf_->peek() + pos_);
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool readLE(T *v) {
+        if(!require(sizeof(T))) {
+            return false;
+        }
+        *v = endian::loadLE<T>(buf_->peek() + pos_);
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    bool readInt8(int8_t *v) { return readBE(v); }
+    bool readUint8(uint8_t *v) { return readBE(v); }
+
+    /**
+     * 无符号 LEB128，失败时返回 false：
+     * 数据不完整时只设置 ok() 为 false；超过 10 个字节或者数值超出 64 位时同时设置 malformed()
+    */
+    bool readVarint(uint64_t *v) {
+        const char *p = buf_->peek() + pos_;
+        const size_t avail = remaining();
+        uint64_t result = 0;
+        for(size_t i = 0; i < avail && i < 10; i++) {
+            uint8_t byte = static_cast<uint8_t>(p[i]);
+            // 第 10 个字节只剩最高的 1 位可用，更大的值（包括继续位）都是溢出
+            if(i == 9 && byte > 1) {
+                break;
+            }
+            result |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+            if(byte < 0x80) {
+                *v = result;
+                pos_ += i + 1;
+                return true;
+            }
+        }
+        if(avail >= 10) {
+            malformed_ = true;
+        }
+        ok_ = false;
+        return false;
+    }
+
+    bool readSignedVarint(int64_t *v) {
+        uint64_t zigzag = 0;
+        if(!readVarint(&zigzag)) {
+            return false;
+        }
+        *v = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+        return true;
+    }
+
+    // 返回指向 Buffer 内部的数据，在 Buffer 被修改之前有效
+    bool readBytes(size_t len, StringPiece *out) {
+        if(!require(len)) {
+            return false;
+        }
+        *out = StringPiece(buf_->peek() + pos_, len);
+        pos_ += len;
+        return true;
+    }
+
+    // varint 长度 + 数据，和 BufferWriter::writeLengthPrefixed 对应；长度格式错误时同样设置 malformed()
+    bool readLengthPrefixed(StringPiece *out) {
+        const size_t start = pos_;
+        uint64_t len = 0;
+        if(!readVarint(&len) || !readBytes(len, out)) {
+            pos_ = start;
+            return false;
+        }
+        return true;
+    }
+
+    bool skip(size_t len) {
+        if(!require(len)) {
+            return false;
+        }
+        pos_ += len;
+        return true;
+    }
+
+    // 把已经读取的数据从 Buffer 中取走
+    void commit() {
+        buf_->retrieve(pos_);
+        pos_ = 0;
+    }
+
+private:
+    bool require(size_t len) {
+        if(remaining() < len) {
+            ok_ = false;
+            return false;
+        }
+        return true;
+    }
+
+    Buffer *buf_;
+    size_t pos_;
+    bool ok_;
+    bool malformed_;
+};
+
+}   // namespace mymuduo
+
+#endif
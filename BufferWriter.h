@@ -0,0 +1,74 @@
+#ifndef _BUFFERWRITER_H
+#define _BUFFERWRITER_H
+
+#include "Buffer.h"
+#include "ByteOrder.h"
+#include "StringPiece.h"
+
+namespace mymuduo {
+
+/**
+ * 向 Buffer 的可写区域写入二进制数据：定长整数（大端 / 小端）、LEB128 变长整数、带长度前缀的字节串
+ * 每次写入先 ensureWriteableBytes，再直接 store 到 beginWirte()，不经过临时变量和 append
+*/
+class BufferWriter {
+public:
+    // varint 最长 10 个字节（64 位）
+    static const size_t kMaxVarintLen = 10;
+
+    explicit BufferWriter(Buffer *buf) : buf_(buf) {}
+
+    template <typename T>
+    void writeBE(T v) {
+        buf_->ensureWriteableBytes(sizeof(T));
+        endian::storeBE(buf_->beginWirte(), v);
+        buf_->hasWritten(sizeof(T));
+    }
+
+    template <typename T>
+    void writeLE(T v) {
+        buf_->ensureWriteableBytes(sizeof(T));
+        endian::storeLE(buf_->beginWirte(), v);
+        buf_->hasWritten(sizeof(T));
+    }
+
+    void writeInt8(int8_t v) { writeBE(v); }
+    void writeUint8(uint8_t v) { writeBE(v); }
+
+    // 无符号 LEB128
+    void writeVarint(uint64_t v) {
+        buf_->ensureWriteableBytes(kMaxVarintLen);
+        char *p = buf_->beginWirte();
+        size_t n = 0;
+        while(v >= 0x80) {
+            p[n++] = static_cast<char>(v | 0x80);
+            v >>= 7;
+        }
+        p[n++] = static_cast<char>(v);
+        buf_->hasWritten(n);
+    }
+
+    // 有符号整数先做 zigzag 编码，绝对值小的负数也只占很少的字节
+    void writeSignedVarint(int64_t v) {
+        writeVarint((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63));
+    }
+
+    void writeBytes(const void *data, size_t len) {
+        buf_->append(data, len);
+    }
+
+    // varint 长度 + 数据
+    void writeLengthPrefixed(const StringPiece &data) {
+        writeVarint(data.size());
+        buf_->append(data.data(), data.size());
+    }
+
+    Buffer *buffer() const { return buf_; }
+
+private:
+    Buffer *buf_;
+};
+
+}   // namespace mymuduo
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef _BYTEORDER_H
+#define _BYTEORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+namespace mymuduo {
+
+/**
+ * 从任意地址（不要求对齐）读写定长整数，同时完成字节序转换
+ * memcpy 固定长度会被编译器优化成一条 load/store，再加上一条 bswap
+*/
+namespace endian {
+
+inline uint8_t byteSwap(uint8_t v) { return v; }
+inline uint16_t byteSwap(uint16_t v) { return __builtin_bswap16(v); }
+inline uint32_t byteSwap(uint32_t v) { return __builtin_bswap32(v); }
+inline uint64_t byteSwap(uint64_t v) { return __builtin_bswap64(v); }
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+const bool kHostLittleEndian = true;
+#else
+const bool kHostLittleEndian = false;
+#endif
+
+// 按字节数选择对应的无符号类型，避免 long / long long 等类型匹配不到 byteSwap 的重载
+template <size_t N> struct UintOf;
+template <> struct UintOf<1> { using type = uint8_t; };
+template <> struct UintOf<2> { using type = uint16_t; };
+template <> struct UintOf<4> { using type = uint32_t; };
+template <> struct UintOf<8> { using type = uint64_t; };
+
+template <typename T>
+inline T loadRaw(const void *p) {
+    T v;
+    ::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+template <typename T>
+inline void storeRaw(void *p, T v) {
+    ::memcpy(p, &v, sizeof(v));
+}
+
+// 大端（网络字节序）
+template <typename T>
+inline T loadBE(const void *p) {
+    static_assert(std::is_integral<T>::value, "integral type required");
+    using U = typename UintOf<sizeof(T)>::type;
+    U v = loadRaw<U>(p);
+    return static_cast<T>(kHostLittleEndian ? byteSwap(v) : v);
+}
+
+template <typename T>
+inline void storeBE(void *p, T v) {
+    static_assert(std::is_integral<T>::value, "integral type required");
+    using U = typename UintOf<sizeof(T)>::type;
+    U u = static_cast<U>(v);
+    storeRaw(p, kHostLittleEndian ? byteSwap(u) : u);
+}
+
+// 小端
+template <typename T>
+inline T loadLE(const void *p) {
+    static_assert(std::is_integral<T>::value, "integral type required");
+    using U = typename UintOf<sizeof(T)>::type;
+    U v = loadRaw<U>(p);
+    return static_cast<T>(kHostLittleEndian ? v : byteSwap(v));
+}
+
+template <typename T>
+inline void storeLE(void *p, T v) {
+    static_assert(std::is_integral<T>::value, "integral type required");
+    using U = typename UintOf<sizeof(T)>::type;
+    U u = static_cast<U>(v);
+    storeRaw(p, kHostLittleEndian ? u : byteSwap(u));
+}
+
+}   // namespace endian
+
+}   // namespace mymuduo
+
+#endif
@@ -17,6 +17,25 @@ using WriteCompleteCallback = std::function<void(const TcpConnectionPtr&)>;
 using MessageCallback = std::function<void(const TcpConnectionPtr&, Buffer *, Timestamp)>;
 
 using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
+using LowWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
+using SlowConsumerCallback = std::function<void(const TcpConnectionPtr&)>;
+
+using TimerCallback = std::function<void()>;
+
+/**
+ * 一个连接用到的全部回调，多个连接共享同一张只读的表（如 TcpServer 每个 loop 一张），
+ * 不需要为每个连接拷贝一遍 std::function；连接单独修改某个回调时才复制一份自己的表
+*/
+struct TcpConnectionCallbacks {
+    ConnectionCallback connectionCallback;
+    MessageCallback messageCallback;
+    WriteCompleteCallback writeCompleteCallback;
+    HighWaterMarkCallback highWaterMarkCallback;
+    LowWaterMarkCallback lowWaterMarkCallback;
+    SlowConsumerCallback slowConsumerCallback;
+    CloseCallback closeCallback;
+};
+using TcpConnectionCallbacksPtr = std::shared_ptr<const TcpConnectionCallbacks>;
 
 }   // namespace mymuduo
 
@@ -15,6 +15,7 @@ Channel::Channel(EventLoop *loop, int fd)
       events_(0),
       revents_(0),
       index_(-1),   // kNew
+      priority_(kNormalPriority),
       tied_(false) {}
 
 Channel::~Channel() {}
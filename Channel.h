@@ -3,6 +3,7 @@
 
 #include "noncopyable.h"
 #include "Timestamp.h"
+#include "EventPriority.h"
 #include <functional>
 #include <memory>
 
@@ -51,6 +52,10 @@ public:
 	bool isWriting() const { return events_ & kWriteEvent; }
 	bool isReading() const { return events_ & kReadEvent; }
 
+	// 同一轮事件循环中，高优先级的 channel 先处理，需要在 loop 线程中设置（或者注册到 Poller 之前）
+	EventPriority priority() const { return priority_; }
+	void setPriority(EventPriority priority) { priority_ = priority; }
+
 	int index() { return index_; }
 	void set_index(int idx) { index_ = idx; }
 
@@ -73,6 +78,7 @@ private:
 	int events_;		// 注册 fd 感兴趣的事件
 	int revents_;		// poller 返回的具体发生的事件
 	int index_;
+	EventPriority priority_;
 
 	std::weak_ptr<void> tie_;
 	bool tied_;
@@ -55,7 +55,8 @@ void Connector::restart() {
 
 void Connector::stop() {
     connect_ = false;
-    loop_->queueInLoop(std::bind(&Connector::stopInLoop, this));
+    // TcpClient 析构时会调用 stop，持有 shared_ptr 保证 stopInLoop 执行时 Connector 还活着
+    loop_->queueInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
 }
 
 void Connector::stopInLoop() {
@@ -113,6 +114,7 @@ void Connector::connecting(int sockfd) {
     channel_.reset(new Channel(loop_, sockfd));
     channel_->setWriteCallback(std::bind(&Connector::handleWrite, this));
     channel_->setErrorCallback(std::bind(&Connector::handleError, this));
+    channel_->setPriority(kHighPriority);
 
     /**
      *   - 如果当连接可用后，且缓存区不满的情况下，调用 epoll_ctl 将 fd 重新注册到 epoll 事件池
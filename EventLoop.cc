@@ -2,12 +2,14 @@
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "TimerQueue.h"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <memory>
+#include <algorithm>
 
 namespace mymuduo {
 
@@ -29,11 +31,15 @@ int createEventfd() {
 EventLoop::EventLoop() 
     : looping_(false),
       quit_(false),
-      callingPendingFunctors_(false),
       threadId_(CurrentThread::tid()),
       poller_(Poller::newDefaultPoller(this)),
       wakeupFd_(createEventfd()),
-      wakeupChannel_(new Channel(this, wakeupFd_)) {
+      wakeupChannel_(new Channel(this, wakeupFd_)),
+      timerQueue_(new TimerQueue(this)),
+      eventHandling_(false),
+      callingPendingFunctors_(false),
+      hasUrgentFunctors_(false),
+      readBudget_(0) {
 
     LOG_DEBUG << "EventLoop created [" << this << "] in thread " << threadId_;
     if(t_loopInThisThread) {
@@ -44,11 +50,13 @@ EventLoop::EventLoop()
 
     // 设置 wakeupFd_ 的事件类型，以及发生事件后的回调操作
     wakeupChannel_->setReadCallback(std::bind(&EventLoop::handleRead, this));
+    wakeupChannel_->setPriority(kHighPriority);
     // 每一个 EventLoop 都将监听 wakeupChannel_ 的 EPOLLIN 读事件了
     wakeupChannel_->enableReading();
 }
 
 EventLoop::~EventLoop() {
+    timerQueue_.reset();
     wakeupChannel_->disableAll();
     wakeupChannel_->remove();
     ::close(wakeupFd_);
@@ -66,10 +74,31 @@ void EventLoop::loop() {
         activeChannels_.clear();
         // 这里 epoll_wait 主要监听两类 fd：一种是和客户端通信的 fd，另一种就是 subLoop 和 mainLoop 通信的 wakeupFd
         pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        // 先按优先级分组，同一个优先级内保持 Poller 返回的顺序；分组以后再修改 channel 的优先级从下一轮开始生效
         for(Channel *channel : activeChannels_) {
-            // Poller 监听到哪些 channel 发生事件了，然后就上报给 EventLoop，通知 channel 处理相应的事件
-            channel->handleEvent(pollReturnTime_);
+            activeByPriority_[channel->priority()].push_back(channel);
+        }
+        /**
+         * Poller 监听到哪些 channel 发生事件了，然后就上报给 EventLoop，通知 channel 处理相应的事件
+         * 高优先级的 channel 先处理；处理低优先级的 channel 之前，先执行已经排队的 kHighPriority 任务，
+         * 这样控制类的任务（如建立连接）最多等一个 channel 的回调，而不是等整轮的数据处理
+         * 低优先级不会被饿死：每一轮所有活跃的 channel 和轮前排队的任务都会处理，
+         * 并且两批高优先级任务之间至少会处理一个低优先级的 channel
+        */
+        eventHandling_ = true;
+        for(int priority = kHighPriority; priority < kNumPriorities; priority++) {
+            for(Channel *&channel : activeByPriority_[priority]) {
+                if(priority != kHighPriority && hasUrgentFunctors_.load(std::memory_order_relaxed)) {
+                    doUrgentFunctors();
+                }
+                // 前面的回调或任务已经把这个 channel 移除（可能已经析构），removeChannel 会把它置空
+                if(channel != nullptr) {
+                    channel->handleEvent(pollReturnTime_);
+                }
+            }
+            activeByPriority_[priority].clear();
         }
+        eventHandling_ = false;
         // 执行当前 EventLoop 事件循环需要处理的回调操作
         /**
          * IO 线程 mainLoop 主要做 accept 操作，而 accept 会返回 fd 后会被包装到 channel 中交给 subLoop
@@ -78,6 +107,8 @@ void EventLoop::loop() {
          * 而这些回调是 mainLoop 事先放到 pendingFunctors_ 中的
         */
         doPendingFunctors();
+        // 例如写合并的连接在这里统一把本轮累积的数据发送出去
+        doEndOfIterationFunctors();
     }
 
     LOG_INFO << "EventLoop [" << this << "] start looping";
@@ -99,21 +130,24 @@ void EventLoop::quit() {
 }
 
 // 在当前 loop 中执行 cb
-void EventLoop::runInLoop(Functor cb) {
+void EventLoop::runInLoop(Functor cb, EventPriority priority) {
     if(isInLoopThread()) {  // 在当前的 loop 线程中，执行 cb
         cb();
     } else {    // 在非当前 loop 线程中执行 cb()，就需要唤醒 loop 所在线程执行 cb
-        queueInLoop(cb);
+        queueInLoop(std::move(cb), priority);
     }
 }
 
 // 把 cb 放入队列中，唤醒 loop 所在的线程，执行 cb
-void EventLoop::queueInLoop(Functor cb) {
+void EventLoop::queueInLoop(Functor cb, EventPriority priority) {
     {
         // 智能锁
         std::unique_lock<std::mutex> lock(mutex_);
-        // push_back() 是拷贝构造，emplace_back() 是直接构造
-        pendingFunctors_.emplace_back(cb);
+        // cb 按值传入，这里移动进队列，避免再拷贝一次 cb 捕获的数据（如跨线程 send 的消息）
+        pendingFunctors_[priority].emplace_back(std::move(cb));
+        if(priority == kHighPriority) {
+            hasUrgentFunctors_ = true;
+        }
     }
 
     /**
@@ -126,6 +160,22 @@ void EventLoop::queueInLoop(Functor cb) {
     }
 }
 
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb) {
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb) {
+    return runAt(addTime(Timestamp::now(), delay), std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb) {
+    return timerQueue_->addTimer(std::move(cb), addTime(Timestamp::now(), interval), interval);
+}
+
+void EventLoop::cancel(TimerId timerId) {
+    timerQueue_->cancel(timerId);
+}
+
 void EventLoop::handleRead() {
     uint64_t one = 1;
     ssize_t n = read(wakeupFd_, &one, sizeof(one));
@@ -151,6 +201,12 @@ void EventLoop::updateChannel(Channel *channel) {
 }
 
 void EventLoop::removeChannel(Channel *channel) {
+    // 处理事件期间移除的 channel 可能还在本轮的待处理列表里，置空以后 loop 会跳过它
+    if(eventHandling_) {
+        for(ChannelList &channels : activeByPriority_) {
+            std::replace(channels.begin(), channels.end(), channel, static_cast<Channel *>(nullptr));
+        }
+    }
     poller_->removeChannel(channel);
 }
 
@@ -158,20 +214,61 @@ bool EventLoop::hasChannel(Channel *channel) {
     return poller_->hasChannel(channel);
 }
 
-// 执行 pendingFunctors_ 中的回调
+// 按优先级执行 pendingFunctors_ 中的回调，执行期间新加入的任务留到下一轮
 void EventLoop::doPendingFunctors() {
-    std::vector<Functor> functors;
+    std::vector<Functor> functors[kNumPriorities];
     callingPendingFunctors_ = true;
 
     {
         std::unique_lock<std::mutex> lock(mutex_);
-        functors.swap(pendingFunctors_);
+        for(int priority = kHighPriority; priority < kNumPriorities; priority++) {
+            functors[priority].swap(pendingFunctors_[priority]);
+        }
+        hasUrgentFunctors_ = false;
+    }
+
+    for(int priority = kHighPriority; priority < kNumPriorities; priority++) {
+        for(const Functor &functor : functors[priority]) {
+            // 执行当前 loop 需要执行的回调操作
+            functor();
+        }
+    }
+
+    callingPendingFunctors_ = false;
+}
+
+// 在处理 channel 的间隙调用，只取出当前已经排队的高优先级任务
+// 这些任务中 queueInLoop 的任务在本轮的 doPendingFunctors 中执行，不需要 wakeup
+void EventLoop::doUrgentFunctors() {
+    std::vector<Functor> functors;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        functors.swap(pendingFunctors_[kHighPriority]);
+        hasUrgentFunctors_ = false;
     }
 
     for(const Functor &functor : functors) {
-        // 执行当前 loop 需要执行的回调操作
         functor();
     }
+}
+
+void EventLoop::runAtEndOfIteration(Functor cb) {
+    assertInLoopThread();
+    endOfIterationFunctors_.emplace_back(std::move(cb));
+}
+
+void EventLoop::doEndOfIterationFunctors() {
+    // 这些回调里 queueInLoop 的任务要在下一轮执行，和 doPendingFunctors 一样需要 wakeup
+    callingPendingFunctors_ = true;
+
+    std::vector<Functor> functors;
+    while(!endOfIterationFunctors_.empty()) {
+        functors.clear();
+        functors.swap(endOfIterationFunctors_);
+        for(const Functor &functor : functors) {
+            functor();
+        }
+    }
 
     callingPendingFunctors_ = false;
 }
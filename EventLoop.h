@@ -4,6 +4,9 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "EventPriority.h"
 
 #include <vector>
 #include <functional>
@@ -15,6 +18,7 @@ namespace mymuduo {
 
 class Channel;
 class Poller;
+class TimerQueue;
 
 // 事件循环类，主要包含了俩大模块：Channel、Poller(epoll 的抽象)
 class EventLoop {
@@ -32,9 +36,35 @@ public:
     Timestamp pollReturnTime() const { return pollReturnTime_; }
 
     // 在当前 loop 中执行 cb
-    void runInLoop(Functor cb);
-    // 把 cb 放入队列中，唤醒 loop 所在的线程，执行 cb
-    void queueInLoop(Functor cb);
+    void runInLoop(Functor cb, EventPriority priority = kNormalPriority);
+    /**
+     * 把 cb 放入队列中，唤醒 loop 所在的线程，执行 cb
+     * kHighPriority 的任务不用等本轮所有的 channel 处理完，在两个低优先级 channel 之间就会执行（见 loop）
+     * 这些任务里可以移除或析构 channel（析构前先 remove），removeChannel 会把它从本轮还没处理的列表中去掉
+    */
+    void queueInLoop(Functor cb, EventPriority priority = kNormalPriority);
+
+    // 在本轮事件循环的最后（处理完活跃的 channel 和 pendingFunctors_ 之后）执行 cb，只能在 loop 线程中调用
+    void runAtEndOfIteration(Functor cb);
+
+    // 定时器，可以在任意线程中调用，回调在 loop 线程中执行
+    // 在 time 时刻执行 cb
+    TimerId runAt(Timestamp time, TimerCallback cb);
+    // delay 秒以后执行 cb
+    TimerId runAfter(double delay, TimerCallback cb);
+    // 每隔 interval 秒执行一次 cb
+    TimerId runEvery(double interval, TimerCallback cb);
+    // 取消定时器
+    void cancel(TimerId timerId);
+
+    /**
+     * 读预算：每轮事件循环中每个连接最多读取 bytes 字节（一次 messageCallback），0 表示不限制
+     * 没有读完的数据留在 socket 中，epoll 是水平触发的，下一轮仍然会返回这个连接，
+     * 这样一个高速发送的连接不会长时间占住 loop，同一个 loop 上其它连接的延迟更稳定
+     * 需要在 loop 线程中调用（或者 loop 开始之前）
+    */
+    void setReadBudget(size_t bytes) { readBudget_ = bytes; }
+    size_t readBudget() const { return readBudget_; }
 
     // 唤醒 loop 所在的线程的
     void wakeup();
@@ -58,8 +88,12 @@ private:
 
     // 主要处理 wake up
     void handleRead();
-    // 执行 pendingFunctors_ 中的回调
+    // 按优先级执行 pendingFunctors_ 中的回调
     void doPendingFunctors();
+    // 只执行 kHighPriority 的回调
+    void doUrgentFunctors();
+    // 执行 endOfIterationFunctors_ 中的回调
+    void doEndOfIterationFunctors();
 
     using ChannelList = std::vector<Channel *>;
 
@@ -78,13 +112,22 @@ private:
     int wakeupFd_;
     std::unique_ptr<Channel> wakeupChannel_;
 
+    std::unique_ptr<TimerQueue> timerQueue_;
+
     // 只记录处于活跃状态的 Channel
     ChannelList activeChannels_;
+    // activeChannels_ 按优先级分组，只在 loop 中使用，保留容量避免每轮分配
+    ChannelList activeByPriority_[kNumPriorities];
+    bool eventHandling_;            // 正在处理 activeByPriority_ 中的 channel，期间移除的 channel 要从里面置空
 
     std::atomic_bool callingPendingFunctors_;       // 标识当前 loop 是否有需要执行的回调操作
-    std::vector<Functor> pendingFunctors_;          // 存储 loop 需要执行的所有的回调操作
+    std::atomic_bool hasUrgentFunctors_;            // pendingFunctors_[kHighPriority] 不为空
+    std::vector<Functor> pendingFunctors_[kNumPriorities];  // 每个优先级一个队列，存储 loop 需要执行的回调操作
     std::mutex mutex_;                              // 互斥锁，用来保护上面 vector 容器的线程安全操作
 
+    std::vector<Functor> endOfIterationFunctors_;   // 只在 loop 线程中访问，不需要加锁
+
+    size_t readBudget_;                             // 每个连接每轮最多读取的字节数，0 表示不限制
 
 };
 
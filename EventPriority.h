@@ -0,0 +1,19 @@
+#ifndef _EVENTPRIORITY_H
+#define _EVENTPRIORITY_H
+
+namespace mymuduo {
+
+/**
+ * Channel 和 queueInLoop 任务的优先级，数值越小优先级越高
+ * EventLoop 每一轮先处理高优先级的 channel，再处理低优先级的，低优先级的工作不会被跳过（见 EventLoop::loop）
+*/
+enum EventPriority {
+    kHighPriority = 0,      // 控制类：wakeup、accept、建立连接、管理 / 健康检查连接
+    kNormalPriority,        // 默认
+    kLowPriority,           // 批量数据
+    kNumPriorities
+};
+
+}   // namespace mymuduo
+
+#endif
@@ -0,0 +1,80 @@
+#include "Histogram.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace mymuduo {
+
+static int bucketOf(uint64_t value) {
+    return value == 0 ? 0 : 64 - __builtin_clzll(value);
+}
+
+void Histogram::add(uint64_t value) {
+    buckets_[bucketOf(value)]++;
+    if(count_ == 0 || value < min_) {
+        min_ = value;
+    }
+    if(value > max_) {
+        max_ = value;
+    }
+    count_++;
+    sum_ += value;
+}
+
+void Histogram::merge(const Histogram &other) {
+    if(other.count_ == 0) {
+        return ;
+    }
+    for(int i = 0; i < kNumBuckets; i++) {
+        buckets_[i] += other.buckets_[i];
+    }
+    if(count_ == 0 || other.min_ < min_) {
+        min_ = other.min_;
+    }
+    if(other.max_ > max_) {
+        max_ = other.max_;
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+}
+
+void Histogram::clear() {
+    ::memset(buckets_, 0, sizeof(buckets_));
+    count_ = 0;
+    sum_ = 0;
+    min_ = 0;
+    max_ = 0;
+}
+
+uint64_t Histogram::percentile(double p) const {
+    if(count_ == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * count_);
+    if(rank >= count_) {
+        rank = count_ - 1;
+    }
+
+    uint64_t seen = 0;
+    for(int i = 0; i < kNumBuckets; i++) {
+        seen += buckets_[i];
+        if(seen > rank) {
+            // 桶的上界，但不会超过实际出现过的最大值
+            uint64_t upper = i == 0 ? 0 : (i == 64 ? UINT64_MAX : (1ULL << i) - 1);
+            return upper < max_ ? upper : max_;
+        }
+    }
+    return max_;
+}
+
+std::string Histogram::toString() const {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "count %llu mean %.1f p50 %llu p99 %llu max %llu",
+             static_cast<unsigned long long>(count_), mean(),
+             static_cast<unsigned long long>(percentile(50)),
+             static_cast<unsigned long long>(percentile(99)),
+             static_cast<unsigned long long>(max_));
+    return buf;
+}
+
+}   // namespace mymuduo
@@ -0,0 +1,44 @@
+#ifndef _HISTOGRAM_H
+#define _HISTOGRAM_H
+
+#include <stdint.h>
+#include <string>
+
+namespace mymuduo {
+
+/**
+ * 以 2 的幂为桶边界的直方图，add 只需要几条指令，适合在事件循环中持续统计
+ * 第 i 个桶（i > 0）统计 [2^(i-1), 2^i) 中的值，第 0 个桶只统计 0，分位数返回所在桶的上界
+*/
+class Histogram {
+public:
+    static const int kNumBuckets = 65;
+
+    Histogram() { clear(); }
+
+    void add(uint64_t value);
+    // 把 other 的统计结果合并到当前直方图
+    void merge(const Histogram &other);
+    void clear();
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ > 0 ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ > 0 ? static_cast<double>(sum_) / count_ : 0.0; }
+    // p 取值为 [0, 100]
+    uint64_t percentile(double p) const;
+
+    // count / mean / p50 / p99 / max
+    std::string toString() const;
+
+private:
+    uint64_t buckets_[kNumBuckets];
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+};
+
+}   // namespace mymuduo
+
+#endif
@@ -0,0 +1,270 @@
+#include "HotRestart.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace mymuduo {
+
+static bool makeUnixAddr(const std::string &path, sockaddr_un *addr) {
+    ::memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if(path.size() >= sizeof(addr->sun_path)) {
+        LOG_ERROR << "unix socket path too long : " << path;
+        return false;
+    }
+    ::memcpy(addr->sun_path, path.c_str(), path.size());
+    return true;
+}
+
+// 一次 sendmsg 发出所有 fd，正文只有 1 个字节
+static bool sendFds(int sockfd, const std::vector<int> &fds) {
+    char data = 'F';
+    iovec iov;
+    iov.iov_base = &data;
+    iov.iov_len = 1;
+
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+    msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if(!fds.empty()) {
+        msg.msg_control = control.data();
+        msg.msg_controllen = control.size();
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        ::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    }
+
+    ssize_t n;
+    do {
+        n = ::sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+    } while(n < 0 && errno == EINTR);
+    if(n != 1) {
+        LOG_ERROR << "HotRestart sendmsg error : " << errno;
+        return false;
+    }
+    return true;
+}
+
+static bool recvFds(int sockfd, std::vector<int> *fds, size_t maxFds) {
+    char data;
+    iovec iov;
+    iov.iov_base = &data;
+    iov.iov_len = 1;
+
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * maxFds));
+    msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+
+    ssize_t n;
+    do {
+        n = ::recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+    } while(n < 0 && errno == EINTR);
+    if(n != 1) {
+        LOG_ERROR << "HotRestart recvmsg error : " << errno;
+        return false;
+    }
+
+    for(cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const int *received = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+            fds->insert(fds->end(), received, received + count);
+        }
+    }
+    if(msg.msg_flags & MSG_CTRUNC) {
+        // 超出 maxFds 的 fd 已经被内核丢弃，收到的这些也不能用
+        LOG_ERROR << "HotRestart received too many fds";
+        for(int fd : *fds) {
+            ::close(fd);
+        }
+        fds->clear();
+        return false;
+    }
+    return true;
+}
+
+HotRestartServer::HotRestartServer(EventLoop *loop, const std::string &path)
+    : loop_(loop),
+      path_(path),
+      listenFd_(-1),
+      peerFd_(-1),
+      tookOver_(false) {}
+
+HotRestartServer::~HotRestartServer() {
+    // 被新进程接管以后 listenFd_ 已经关闭，path 上是新进程的 socket，不能删除
+    if(listenFd_ >= 0) {
+        stop();
+        ::unlink(path_.c_str());
+    }
+    if(peerFd_ >= 0) {
+        peerChannel_->disableAll();
+        peerChannel_->remove();
+        ::close(peerFd_);
+    }
+}
+
+bool HotRestartServer::start() {
+    loop_->assertInLoopThread();
+    if(fds_.size() > HotRestartClient::kMaxFds) {
+        LOG_ERROR << "HotRestartServer too many fds : " << fds_.size();
+        return false;
+    }
+    sockaddr_un addr;
+    if(!makeUnixAddr(path_, &addr)) {
+        return false;
+    }
+
+    listenFd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(listenFd_ < 0) {
+        LOG_ERROR << "HotRestartServer socket error : " << errno;
+        return false;
+    }
+    // 上一个进程留下的 socket 文件（旧进程仍然持有它已经打开的 socket，不受影响）
+    ::unlink(path_.c_str());
+    if(::bind(listenFd_, (sockaddr *)&addr, sizeof(addr)) < 0 || ::listen(listenFd_, 1) < 0) {
+        LOG_ERROR << "HotRestartServer bind / listen " << path_ << " error : " << errno;
+        ::close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+
+    listenChannel_.reset(new Channel(loop_, listenFd_));
+    listenChannel_->setReadCallback(std::bind(&HotRestartServer::handleAccept, this));
+    listenChannel_->setPriority(kHighPriority);
+    listenChannel_->enableReading();
+    LOG_INFO << "HotRestartServer listening on " << path_;
+    return true;
+}
+
+void HotRestartServer::handleAccept() {
+    int connfd = ::accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if(connfd < 0) {
+        LOG_ERROR << "HotRestartServer accept error : " << errno;
+        return ;
+    }
+    if(peerFd_ >= 0 || tookOver_) {
+        // 已经有一个新进程在接管
+        ::close(connfd);
+        return ;
+    }
+
+    // 只有 1 个字节加上控制信息，刚建立的 unix socket 发送缓冲区一定放得下
+    if(!sendFds(connfd, fds_)) {
+        ::close(connfd);
+        return ;
+    }
+    LOG_INFO << "HotRestartServer sent " << fds_.size() << " fds, waiting for the new process";
+
+    peerFd_ = connfd;
+    peerChannel_.reset(new Channel(loop_, peerFd_));
+    peerChannel_->setReadCallback(std::bind(&HotRestartServer::handleReady, this));
+    peerChannel_->setPriority(kHighPriority);
+    peerChannel_->enableReading();
+}
+
+void HotRestartServer::handleReady() {
+    char ready = 0;
+    ssize_t n = ::read(peerFd_, &ready, 1);
+    if(n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return ;
+    }
+
+    // 不能在 peerChannel_ 自己的回调中析构它，交给 closePeer 稍后处理
+    peerChannel_->disableAll();
+    peerChannel_->remove();
+    loop_->queueInLoop(std::bind(&HotRestartServer::closePeer, this));
+
+    if(n == 1) {
+        LOG_INFO << "HotRestartServer taken over by the new process";
+        tookOver_ = true;
+        stop();
+        if(takeoverCallback_) {
+            takeoverCallback_();
+        }
+    } else {
+        // 新进程在准备好之前退出了，旧进程继续服务，等待下一次接管
+        LOG_ERROR << "HotRestartServer new process exited before ready";
+    }
+}
+
+void HotRestartServer::closePeer() {
+    if(peerFd_ >= 0) {
+        ::close(peerFd_);
+        peerFd_ = -1;
+    }
+    peerChannel_.reset();
+}
+
+void HotRestartServer::stop() {
+    if(listenFd_ < 0) {
+        return ;
+    }
+    listenChannel_->disableAll();
+    listenChannel_->remove();
+    ::close(listenFd_);
+    listenFd_ = -1;
+    listenChannel_.reset();
+}
+
+HotRestartClient::HotRestartClient(const std::string &path)
+    : path_(path),
+      sockfd_(-1) {}
+
+HotRestartClient::~HotRestartClient() {
+    if(sockfd_ >= 0) {
+        ::close(sockfd_);
+    }
+}
+
+bool HotRestartClient::fetch(std::vector<int> *fds) {
+    sockaddr_un addr;
+    if(!makeUnixAddr(path_, &addr)) {
+        return false;
+    }
+    sockfd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(sockfd_ < 0) {
+        LOG_ERROR << "HotRestartClient socket error : " << errno;
+        return false;
+    }
+    if(::connect(sockfd_, (sockaddr *)&addr, sizeof(addr)) < 0) {
+        // 没有旧进程，正常启动
+        LOG_INFO << "HotRestartClient no old process on " << path_;
+        ::close(sockfd_);
+        sockfd_ = -1;
+        return false;
+    }
+    if(!recvFds(sockfd_, fds, kMaxFds)) {
+        ::close(sockfd_);
+        sockfd_ = -1;
+        return false;
+    }
+    LOG_INFO << "HotRestartClient received " << fds->size() << " fds from " << path_;
+    return true;
+}
+
+bool HotRestartClient::ready() {
+    if(sockfd_ < 0) {
+        return false;
+    }
+    char ready = 'R';
+    bool ok = ::send(sockfd_, &ready, 1, MSG_NOSIGNAL) == 1;
+    ::close(sockfd_);
+    sockfd_ = -1;
+    return ok;
+}
+
+}   // namespace mymuduo
@@ -0,0 +1,82 @@
+#ifndef _HOTRESTART_H
+#define _HOTRESTART_H
+
+#include "noncopyable.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mymuduo {
+
+class Channel;
+class EventLoop;
+
+/**
+ * 热重启：新进程启动时通过 unix domain socket 向旧进程要监听 socket 的 fd（SCM_RIGHTS），
+ * 两个进程在同一个 socket 上 accept，新进程准备好以后通知旧进程，旧进程再走优雅关闭，整个过程中端口一直在监听
+ *
+ *      旧进程                                  新进程
+ *      HotRestartServer::start()
+ *                                              HotRestartClient::fetch()      <- 收到监听 socket
+ *                                              TcpServer(loop, fd, name).start()
+ *                                              HotRestartClient::ready()
+ *      takeoverCallback_()                     HotRestartServer::start()      <- 等待下一次升级
+ *      TcpServer::shutdownGracefully()
+*/
+
+// 旧进程一侧，运行在 mainLoop 中，需要比 loop 活得更久
+class HotRestartServer : noncopyable {
+public:
+    using TakeoverCallback = std::function<void()>;
+
+    HotRestartServer(EventLoop *loop, const std::string &path);
+    ~HotRestartServer();
+
+    // 交给新进程的 fd（一般是 TcpServer::listenFd()），需要在 start 之前设置
+    void setFds(const std::vector<int> &fds) { fds_ = fds; }
+    // 新进程已经开始接收连接，旧进程可以开始优雅关闭，只会回调一次
+    void setTakeoverCallback(const TakeoverCallback &cb) { takeoverCallback_ = cb; }
+
+    // 删除 path 上已经存在的 socket 文件，然后开始监听，失败返回 false
+    bool start();
+
+private:
+    void handleAccept();
+    void handleReady();
+    void closePeer();
+    void stop();
+
+    EventLoop *loop_;
+    const std::string path_;
+    int listenFd_;
+    std::unique_ptr<Channel> listenChannel_;
+    int peerFd_;                        // 正在接管的新进程，同时只处理一个
+    std::unique_ptr<Channel> peerChannel_;
+    std::vector<int> fds_;
+    TakeoverCallback takeoverCallback_;
+    bool tookOver_;
+};
+
+// 新进程一侧，在启动 loop 之前阻塞调用
+class HotRestartClient : noncopyable {
+public:
+    static const size_t kMaxFds = 16;
+
+    explicit HotRestartClient(const std::string &path);
+    ~HotRestartClient();
+
+    // 连接旧进程并接收它的 fd，没有旧进程（或者出错）时返回 false
+    bool fetch(std::vector<int> *fds);
+    // 通知旧进程开始优雅关闭，需要在 fetch 成功之后调用
+    bool ready();
+
+private:
+    const std::string path_;
+    int sockfd_;
+};
+
+}   // namespace mymuduo
+
+#endif
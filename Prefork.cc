@@ -0,0 +1,338 @@
+#include "Prefork.h"
+#include "Channel.h"
+#include "CurrentThread.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpServer.h"
+#include "Timestamp.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <type_traits>
+#include <algorithm>
+
+namespace mymuduo {
+
+static_assert(std::is_trivially_copyable<TrafficStats>::value, "TrafficStats is sent as raw bytes");
+
+// 同一个编号的 worker 两次启动之间的最小间隔
+static const int64_t kMinRespawnInterval = Timestamp::kMicroSecondsPerSecond;
+
+// master 通过 signalfd 处理的信号，worker 中需要恢复
+static void masterSignals(sigset_t *mask) {
+    ::sigemptyset(mask);
+    ::sigaddset(mask, SIGCHLD);
+    ::sigaddset(mask, SIGINT);
+    ::sigaddset(mask, SIGTERM);
+}
+
+static int64_t nowMicroSeconds() {
+    return Timestamp::now().microSecondsSinceEpoch();
+}
+
+PreforkWorker::PreforkWorker(int index, int sockfd)
+    : index_(index),
+      sockfd_(sockfd),
+      loop_(nullptr),
+      server_(nullptr),
+      drainTimeout_(0.0) {}
+
+// workerMain 返回时 attach 的 loop 已经析构，这里不能再访问 loop，只释放 Channel 对象
+PreforkWorker::~PreforkWorker() {
+    ::close(sockfd_);
+}
+
+void PreforkWorker::attach(EventLoop *loop, TcpServer *server, double interval, double drainTimeout) {
+    loop->assertInLoopThread();
+    loop_ = loop;
+    server_ = server;
+    drainTimeout_ = drainTimeout;
+
+    channel_.reset(new Channel(loop, sockfd_));
+    channel_->setReadCallback(std::bind(&PreforkWorker::handleMasterClose, this));
+    channel_->setPriority(kHighPriority);
+    channel_->enableReading();
+    loop->runEvery(interval, std::bind(&PreforkWorker::report, this));
+}
+
+void PreforkWorker::report() {
+    TrafficStats stats = server_->trafficStats();
+    // master 来不及读取时丢掉这次上报，不阻塞 loop
+    ::send(sockfd_, &stats, sizeof(stats), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+void PreforkWorker::handleMasterClose() {
+    char buf[64];
+    ssize_t n = ::recv(sockfd_, buf, sizeof(buf), MSG_DONTWAIT);
+    if(n > 0 || (n < 0 && (errno == EAGAIN || errno == EINTR))) {
+        return ;
+    }
+
+    LOG_INFO << "PreforkWorker " << index_ << " - master closed, shutting down";
+    channel_->disableAll();
+    channel_->remove();
+    EventLoop *loop = loop_;
+    server_->shutdownGracefully(drainTimeout_, nullptr, [loop](const TcpServer::ShutdownStats &) {
+        loop->quit();
+    });
+}
+
+PreforkServer::PreforkServer(int numWorkers, const WorkerMain &workerMain)
+    : workerMain_(workerMain),
+      statsInterval_(1.0),
+      stopTimeout_(10.0),
+      signalFd_(-1),
+      stopping_(false),
+      restarts_(0),
+      workers_(numWorkers) {}
+
+PreforkServer::~PreforkServer() {
+    for(WorkerSlot &slot : workers_) {
+        if(slot.sockfd >= 0) {
+            ::close(slot.sockfd);
+        }
+    }
+}
+
+int PreforkServer::run() {
+    sigset_t mask;
+    masterSignals(&mask);
+    sigset_t oldMask;
+    ::sigprocmask(SIG_BLOCK, &mask, &oldMask);
+    signalFd_ = ::signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if(signalFd_ < 0) {
+        LOG_ERROR << "PreforkServer signalfd error : " << errno;
+        ::sigprocmask(SIG_SETMASK, &oldMask, nullptr);
+        return -1;
+    }
+
+    for(size_t i = 0; i < workers_.size(); i++) {
+        spawn(i);
+    }
+
+    const int64_t statsInterval = static_cast<int64_t>(statsInterval_ * Timestamp::kMicroSecondsPerSecond);
+    int64_t nextReport = nowMicroSeconds() + statsInterval;
+    int64_t stopDeadline = 0;
+    bool killed = false;
+
+    std::vector<pollfd> pollfds;
+    std::vector<size_t> pollIndex;      // pollfds[i + 1] 对应的 worker 编号
+    while(true) {
+        bool running = false;
+        for(const WorkerSlot &slot : workers_) {
+            running = running || slot.pid > 0;
+        }
+        if(stopping_ && !running) {
+            break;
+        }
+
+        // poll 的超时时间取下一次上报、重新 fork、强制结束中最早的一个
+        const int64_t now = nowMicroSeconds();
+        int64_t wakeAt = statsCallback_ ? nextReport : now + statsInterval;
+        for(const WorkerSlot &slot : workers_) {
+            if(slot.respawnAt > 0 && !stopping_) {
+                wakeAt = std::min(wakeAt, slot.respawnAt);
+            }
+        }
+        if(stopping_ && !killed) {
+            wakeAt = std::min(wakeAt, stopDeadline);
+        }
+        int timeoutMs = static_cast<int>(std::max<int64_t>(0, (wakeAt - now + 999) / 1000));
+
+        pollfds.clear();
+        pollIndex.clear();
+        pollfds.push_back(pollfd{signalFd_, POLLIN, 0});
+        for(size_t i = 0; i < workers_.size(); i++) {
+            if(workers_[i].sockfd >= 0) {
+                pollfds.push_back(pollfd{workers_[i].sockfd, POLLIN, 0});
+                pollIndex.push_back(i);
+            }
+        }
+
+        int n = ::poll(pollfds.data(), pollfds.size(), timeoutMs);
+        if(n < 0 && errno != EINTR) {
+            LOG_ERROR << "PreforkServer poll error : " << errno;
+            break;
+        }
+
+        if(n > 0 && (pollfds[0].revents & POLLIN)) {
+            signalfd_siginfo info;
+            while(::read(signalFd_, &info, sizeof(info)) == sizeof(info)) {
+                if(info.ssi_signo == SIGCHLD) {
+                    int status = 0;
+                    pid_t pid;
+                    while((pid = ::waitpid(-1, &status, WNOHANG)) > 0) {
+                        handleWorkerExit(pid, status);
+                    }
+                } else if(!stopping_) {
+                    LOG_INFO << "PreforkServer received signal " << info.ssi_signo << ", stopping workers";
+                    stopWorkers();
+                    stopDeadline = nowMicroSeconds()
+                        + static_cast<int64_t>(stopTimeout_ * Timestamp::kMicroSecondsPerSecond);
+                }
+            }
+        }
+        for(size_t i = 1; n > 0 && i < pollfds.size(); i++) {
+            if(pollfds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                handleWorkerMessage(pollIndex[i - 1]);
+            }
+        }
+
+        const int64_t after = nowMicroSeconds();
+        if(!stopping_) {
+            for(size_t i = 0; i < workers_.size(); i++) {
+                if(workers_[i].respawnAt > 0 && workers_[i].respawnAt <= after) {
+                    spawn(i);
+                }
+            }
+        } else if(!killed && after >= stopDeadline) {
+            // worker 没有在规定时间内退出
+            for(const WorkerSlot &slot : workers_) {
+                if(slot.pid > 0) {
+                    LOG_ERROR << "PreforkServer worker " << slot.pid << " did not exit in time, killing";
+                    ::kill(slot.pid, SIGKILL);
+                }
+            }
+            killed = true;
+        }
+        if(statsCallback_ && after >= nextReport) {
+            reportStats();
+            nextReport = after + statsInterval;
+        }
+    }
+
+    ::close(signalFd_);
+    signalFd_ = -1;
+    ::sigprocmask(SIG_SETMASK, &oldMask, nullptr);
+    return 0;
+}
+
+bool PreforkServer::spawn(size_t index) {
+    WorkerSlot &slot = workers_[index];
+    slot.respawnAt = 0;
+
+    int sv[2];
+    if(::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+        LOG_ERROR << "PreforkServer socketpair error : " << errno;
+        slot.respawnAt = nowMicroSeconds() + kMinRespawnInterval;
+        return false;
+    }
+
+    // 避免 stdio 缓冲区中的内容在子进程中再输出一次
+    ::fflush(stdout);
+    ::fflush(stderr);
+    pid_t pid = ::fork();
+    if(pid < 0) {
+        LOG_ERROR << "PreforkServer fork error : " << errno;
+        ::close(sv[0]);
+        ::close(sv[1]);
+        slot.respawnAt = nowMicroSeconds() + kMinRespawnInterval;
+        return false;
+    }
+
+    if(pid == 0) {
+        // worker 进程：缓存的 tid 是 master 的，需要重新获取
+        CurrentThread::t_cachedTid = 0;
+        ::close(sv[0]);
+        ::close(signalFd_);
+        for(const WorkerSlot &other : workers_) {
+            if(other.sockfd >= 0) {
+                ::close(other.sockfd);
+            }
+        }
+        sigset_t mask;
+        masterSignals(&mask);
+        ::sigprocmask(SIG_UNBLOCK, &mask, nullptr);
+
+        {
+            PreforkWorker worker(static_cast<int>(index), sv[1]);
+            workerMain_(&worker);
+        }
+        ::fflush(stdout);
+        ::fflush(stderr);
+        // 不执行 master 的 atexit 和全局对象的析构
+        ::_exit(0);
+    }
+
+    ::close(sv[1]);
+    slot.pid = pid;
+    slot.sockfd = sv[0];
+    slot.startedAt = nowMicroSeconds();
+    slot.stats = TrafficStats();
+    LOG_INFO << "PreforkServer worker " << index << " started, pid " << pid;
+    return true;
+}
+
+void PreforkServer::handleWorkerMessage(size_t index) {
+    WorkerSlot &slot = workers_[index];
+    TrafficStats stats;
+    ssize_t n = ::recv(slot.sockfd, &stats, sizeof(stats), MSG_DONTWAIT);
+    if(n == sizeof(stats)) {
+        slot.stats = stats;
+    } else if(n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        // worker 关闭了它那一端，进程的退出由 SIGCHLD 处理
+        ::close(slot.sockfd);
+        slot.sockfd = -1;
+    }
+}
+
+void PreforkServer::handleWorkerExit(pid_t pid, int status) {
+    for(size_t i = 0; i < workers_.size(); i++) {
+        WorkerSlot &slot = workers_[i];
+        if(slot.pid != pid) {
+            continue;
+        }
+
+        if(WIFSIGNALED(status)) {
+            LOG_ERROR << "PreforkServer worker " << i << " (pid " << pid << ") killed by signal " << WTERMSIG(status);
+        } else {
+            LOG_INFO << "PreforkServer worker " << i << " (pid " << pid << ") exited with " << WEXITSTATUS(status);
+        }
+
+        // 已经退出的 worker 的累计流量保留下来，当前连接数清零
+        slot.stats.activeConnections = 0;
+        retired_.merge(slot.stats);
+        slot.stats = TrafficStats();
+        if(slot.sockfd >= 0) {
+            ::close(slot.sockfd);
+            slot.sockfd = -1;
+        }
+        slot.pid = -1;
+
+        if(!stopping_) {
+            ++restarts_;
+            slot.respawnAt = std::max(nowMicroSeconds(), slot.startedAt + kMinRespawnInterval);
+        }
+        return ;
+    }
+}
+
+void PreforkServer::reportStats() {
+    TrafficStats total = retired_;
+    std::vector<TrafficStats> perWorker;
+    for(const WorkerSlot &slot : workers_) {
+        total.merge(slot.stats);
+        perWorker.push_back(slot.stats);
+    }
+    statsCallback_(total, perWorker);
+}
+
+void PreforkServer::stopWorkers() {
+    stopping_ = true;
+    // 关闭 master 一端，worker 读到 EOF 以后优雅退出
+    for(WorkerSlot &slot : workers_) {
+        slot.respawnAt = 0;
+        if(slot.sockfd >= 0) {
+            ::close(slot.sockfd);
+            slot.sockfd = -1;
+        }
+    }
+}
+
+}   // namespace mymuduo
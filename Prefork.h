@@ -0,0 +1,114 @@
+#ifndef _PREFORK_H
+#define _PREFORK_H
+
+#include "noncopyable.h"
+#include "TrafficCounters.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <sys/types.h>
+
+namespace mymuduo {
+
+class Channel;
+class EventLoop;
+class TcpServer;
+
+/**
+ * prefork 多进程模式中 worker 进程一侧的句柄，由 PreforkServer 传给 workerMain
+ * worker 通过一对 SOCK_SEQPACKET socket 和 master 通信：定期上报流量统计；master 关闭它那一端（要求退出或者 master 已经退出）时，
+ * worker 会优雅关闭 TcpServer 并退出 loop
+*/
+class PreforkWorker : noncopyable {
+public:
+    PreforkWorker(int index, int sockfd);
+    ~PreforkWorker();
+
+    // worker 的编号，从 0 开始，重启以后编号不变
+    int index() const { return index_; }
+
+    /**
+     * 在 loop 中每隔 interval 秒把 server 的流量统计发给 master，收到 master 的退出通知后
+     * 调用 server->shutdownGracefully(drainTimeout)，所有连接关闭以后 loop->quit()；需要在 loop 线程中调用
+    */
+    void attach(EventLoop *loop, TcpServer *server, double interval = 1.0, double drainTimeout = 5.0);
+
+private:
+    void report();
+    void handleMasterClose();
+
+    const int index_;
+    const int sockfd_;
+    EventLoop *loop_;
+    TcpServer *server_;
+    double drainTimeout_;
+    std::unique_ptr<Channel> channel_;
+};
+
+/**
+ * prefork 多进程模式：master 进程 fork 出 numWorkers 个 worker 进程，每个 worker 运行自己的 EventLoop / TcpServer
+ * （一般使用 TcpServer::kReusePort，由内核在各个 worker 的监听 socket 之间分配连接），进程之间不共享内存和分配器
+ *
+ * master 不运行 EventLoop，只用 poll 等待 worker 的统计信息和信号：
+ *      - worker 异常退出时重新 fork（同一个编号两次启动至少间隔 1 秒，避免启动即崩溃时反复 fork）
+ *      - 收到 SIGINT / SIGTERM 后通知所有 worker 优雅退出，等待它们全部退出后 run 返回
+ *
+ * 注意：fork 之前 master 不能启动任何线程（包括 initLog 启动的异步日志线程），日志请在 workerMain 中初始化
+*/
+class PreforkServer : noncopyable {
+public:
+    // 在 worker 进程中执行，返回以后 worker 进程退出
+    using WorkerMain = std::function<void(PreforkWorker *worker)>;
+    // 所有 worker 的流量统计之和，以及每个 worker 最近一次上报的统计，在 master 中调用
+    using StatsCallback = std::function<void(const TrafficStats &total, const std::vector<TrafficStats> &perWorker)>;
+
+    PreforkServer(int numWorkers, const WorkerMain &workerMain);
+    ~PreforkServer();
+
+    // 每隔 interval 秒回调一次，需要在 run 之前设置
+    void setStatsCallback(const StatsCallback &cb, double interval = 1.0) {
+        statsCallback_ = cb;
+        statsInterval_ = interval;
+    }
+    // 通知 worker 退出以后最多等待多久，超时的 worker 会被 SIGKILL
+    void setStopTimeout(double seconds) { stopTimeout_ = seconds; }
+
+    // 阻塞运行，直到收到 SIGINT / SIGTERM 并且所有 worker 都已经退出；返回 0 表示正常退出
+    int run();
+
+    // worker 被重新 fork 的次数
+    int restarts() const { return restarts_; }
+
+private:
+    struct WorkerSlot {
+        WorkerSlot() : pid(-1), sockfd(-1), startedAt(0), respawnAt(0) {}
+
+        pid_t pid;
+        int sockfd;             // master 一端，-1 表示没有在运行的 worker
+        int64_t startedAt;      // 微秒
+        int64_t respawnAt;      // 不为 0 表示等待重新 fork
+        TrafficStats stats;     // 最近一次上报
+    };
+
+    bool spawn(size_t index);
+    void handleWorkerMessage(size_t index);
+    void handleWorkerExit(pid_t pid, int status);
+    void reportStats();
+    void stopWorkers();
+
+    WorkerMain workerMain_;
+    StatsCallback statsCallback_;
+    double statsInterval_;
+    double stopTimeout_;
+
+    int signalFd_;
+    bool stopping_;
+    int restarts_;
+    std::vector<WorkerSlot> workers_;
+    TrafficStats retired_;      // 已经退出的 worker 最后一次上报的统计（不含当前连接数）
+};
+
+}   // namespace mymuduo
+
+#endif
@@ -1,17 +1,28 @@
 #include "Socket.h"
 #include "Logger.h"
 #include "InetAddress.h"
+#include "SocketOptions.h"
+#include "TcpInfo.h"
 
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/tcp.h>
 #include <string.h>
+#include <errno.h>
 
 namespace mymuduo {
 
+static void setIntOption(int sockfd, int level, int optname, int optval, const char *name) {
+    if(::setsockopt(sockfd, level, optname, &optval, sizeof(optval)) < 0) {
+        LOG_ERROR << "setsockopt " << name << " = " << optval << " on fd " << sockfd << " error : " << errno;
+    }
+}
+
 Socket::~Socket() {
-    ::close(sockfd_);
+    if(sockfd_ >= 0) {
+        ::close(sockfd_);
+    }
 }
 
 void Socket::bindAddress(const InetAddress &localaddr) {
@@ -20,8 +31,8 @@ void Socket::bindAddress(const InetAddress &localaddr) {
     }
 }
 
-void Socket::listen() {
-    if(::listen(sockfd_, 1024) != 0) {
+void Socket::listen(int backlog) {
+    if(::listen(sockfd_, backlog) != 0) {
         LOG_FATAL << "listen sockfd: " << sockfd_ << " fail";
     }
 }
@@ -48,6 +59,17 @@ void Socket::shutdownWrite() {
     }
 }
 
+void Socket::close() {
+    if(sockfd_ >= 0) {
+        ::close(sockfd_);
+        sockfd_ = -1;
+    }
+}
+
+bool Socket::getTcpInfo(TcpInfo *info) const {
+    return TcpInfo::get(sockfd_, info);
+}
+
 void Socket::setTcpNoDelay(bool on) {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
@@ -68,4 +90,107 @@ void Socket::setKeepAlive(bool on) {
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
 }
 
+bool Socket::setZeroCopy(bool on) {
+#ifdef SO_ZEROCOPY
+    int optval = on ? 1 : 0;
+    if(::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof(optval)) < 0) {
+        LOG_ERROR << "Socket::setZeroCopy error : " << errno;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Socket::setSendBufferSize(int bytes) {
+    setIntOption(sockfd_, SOL_SOCKET, SO_SNDBUF, bytes, "SO_SNDBUF");
+}
+
+void Socket::setRecvBufferSize(int bytes) {
+    setIntOption(sockfd_, SOL_SOCKET, SO_RCVBUF, bytes, "SO_RCVBUF");
+}
+
+void Socket::setTcpQuickAck(bool on) {
+    setIntOption(sockfd_, IPPROTO_TCP, TCP_QUICKACK, on ? 1 : 0, "TCP_QUICKACK");
+}
+
+void Socket::setTcpNotSentLowat(int bytes) {
+#ifdef TCP_NOTSENT_LOWAT
+    setIntOption(sockfd_, IPPROTO_TCP, TCP_NOTSENT_LOWAT, bytes, "TCP_NOTSENT_LOWAT");
+#else
+    LOG_ERROR << "Socket::setTcpNotSentLowat not supported";
+#endif
+}
+
+void Socket::setTcpUserTimeout(int milliseconds) {
+#ifdef TCP_USER_TIMEOUT
+    setIntOption(sockfd_, IPPROTO_TCP, TCP_USER_TIMEOUT, milliseconds, "TCP_USER_TIMEOUT");
+#else
+    LOG_ERROR << "Socket::setTcpUserTimeout not supported";
+#endif
+}
+
+void Socket::setKeepAliveParams(int idleSeconds, int intervalSeconds, int count) {
+    if(idleSeconds >= 0) {
+        setIntOption(sockfd_, IPPROTO_TCP, TCP_KEEPIDLE, idleSeconds, "TCP_KEEPIDLE");
+    }
+    if(intervalSeconds >= 0) {
+        setIntOption(sockfd_, IPPROTO_TCP, TCP_KEEPINTVL, intervalSeconds, "TCP_KEEPINTVL");
+    }
+    if(count >= 0) {
+        setIntOption(sockfd_, IPPROTO_TCP, TCP_KEEPCNT, count, "TCP_KEEPCNT");
+    }
+}
+
+void Socket::setLinger(bool on, int seconds) {
+    struct linger ling;
+    ling.l_onoff = on ? 1 : 0;
+    ling.l_linger = seconds;
+    if(::setsockopt(sockfd_, SOL_SOCKET, SO_LINGER, &ling, sizeof(ling)) < 0) {
+        LOG_ERROR << "setsockopt SO_LINGER on fd " << sockfd_ << " error : " << errno;
+    }
+}
+
+void Socket::setTcpDeferAccept(int seconds) {
+    setIntOption(sockfd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, seconds, "TCP_DEFER_ACCEPT");
+}
+
+void Socket::setTcpFastOpen(int queueLen) {
+#ifdef TCP_FASTOPEN
+    setIntOption(sockfd_, IPPROTO_TCP, TCP_FASTOPEN, queueLen, "TCP_FASTOPEN");
+#else
+    LOG_ERROR << "Socket::setTcpFastOpen not supported";
+#endif
+}
+
+void Socket::applyOptions(const SocketOptions &options) {
+    const int kUnset = SocketOptions::kUnset;
+    if(options.tcpNoDelay != kUnset) {
+        setTcpNoDelay(options.tcpNoDelay != 0);
+    }
+    if(options.sendBufferSize != kUnset) {
+        setSendBufferSize(options.sendBufferSize);
+    }
+    if(options.recvBufferSize != kUnset) {
+        setRecvBufferSize(options.recvBufferSize);
+    }
+    if(options.tcpQuickAck != kUnset) {
+        setTcpQuickAck(options.tcpQuickAck != 0);
+    }
+    if(options.notSentLowat != kUnset) {
+        setTcpNotSentLowat(options.notSentLowat);
+    }
+    if(options.userTimeoutMs != kUnset) {
+        setTcpUserTimeout(options.userTimeoutMs);
+    }
+    if(options.keepAlive != kUnset) {
+        setKeepAlive(options.keepAlive != 0);
+    }
+    setKeepAliveParams(options.keepIdle, options.keepInterval, options.keepCount);
+    if(options.lingerSeconds != kUnset) {
+        setLinger(true, options.lingerSeconds);
+    }
+}
+
 }   // namespace mymuduo
\ No newline at end of file
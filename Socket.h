@@ -6,6 +6,8 @@
 namespace mymuduo {
 
 class InetAddress;
+struct SocketOptions;
+struct TcpInfo;
 
 // 封装 socket fd
 class Socket : noncopyable {
@@ -16,18 +18,39 @@ public:
 
     int fd() const { return sockfd_; }
     void bindAddress(const InetAddress &localaddr);
-    void listen();
+    void listen(int backlog = 1024);
     int accept(InetAddress *peeraddr);
 
     void shutdownWrite();
+    // 提前关闭 fd，之后析构时不会再关闭
+    void close();
+
+    // 读取 TCP_INFO，失败返回 false
+    bool getTcpInfo(TcpInfo *info) const;
 
     void setTcpNoDelay(bool on);
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+    // 开启 SO_ZEROCOPY，之后才能使用 MSG_ZEROCOPY 发送，返回 false 表示内核不支持
+    bool setZeroCopy(bool on);
+
+    void setSendBufferSize(int bytes);
+    void setRecvBufferSize(int bytes);
+    void setTcpQuickAck(bool on);
+    void setTcpNotSentLowat(int bytes);
+    void setTcpUserTimeout(int milliseconds);
+    // 参数小于 0 的项保持默认值
+    void setKeepAliveParams(int idleSeconds, int intervalSeconds, int count);
+    void setLinger(bool on, int seconds);
+    // 监听 socket 的选项，需要在 listen 之前设置
+    void setTcpDeferAccept(int seconds);
+    void setTcpFastOpen(int queueLen);
+    // 设置 options 中所有不是 kUnset 的选项
+    void applyOptions(const SocketOptions &options);
 
 private:
-    const int sockfd_;
+    int sockfd_;
 };
 
 }   // namespace mymuduo
@@ -0,0 +1,74 @@
+#ifndef _SOCKETOPTIONS_H
+#define _SOCKETOPTIONS_H
+
+namespace mymuduo {
+
+/**
+ * 连接 socket 的选项，由 TcpServer / TcpClient 在每个新连接建立时设置一次
+ * 所有字段默认为 kUnset，表示保持内核（或 TcpConnection）的默认值；开关类的选项取值为 0 或 1
+*/
+struct SocketOptions {
+    static const int kUnset = -1;
+
+    SocketOptions()
+        : tcpNoDelay(kUnset),
+          sendBufferSize(kUnset),
+          recvBufferSize(kUnset),
+          tcpQuickAck(kUnset),
+          notSentLowat(kUnset),
+          userTimeoutMs(kUnset),
+          keepAlive(kUnset),
+          keepIdle(kUnset),
+          keepInterval(kUnset),
+          keepCount(kUnset),
+          lingerSeconds(kUnset) {}
+
+    // 低延迟：关闭 Nagle，开启 quickack，内核中未发送的数据超过 16K 就不再报告可写
+    static SocketOptions lowLatency() {
+        SocketOptions options;
+        options.tcpNoDelay = 1;
+        options.tcpQuickAck = 1;
+        options.notSentLowat = 16 * 1024;
+        return options;
+    }
+
+    // 大吞吐：使用 4M 的发送 / 接收缓冲区（会关闭内核对缓冲区大小的自动调整）
+    static SocketOptions bulk() {
+        SocketOptions options;
+        options.sendBufferSize = 4 * 1024 * 1024;
+        options.recvBufferSize = 4 * 1024 * 1024;
+        return options;
+    }
+
+    int tcpNoDelay;         // TCP_NODELAY
+    int sendBufferSize;     // SO_SNDBUF，字节
+    int recvBufferSize;     // SO_RCVBUF，字节
+    int tcpQuickAck;        // TCP_QUICKACK，内核之后可能会自动关闭，这里只在连接建立时设置一次
+    int notSentLowat;       // TCP_NOTSENT_LOWAT，字节
+    int userTimeoutMs;      // TCP_USER_TIMEOUT，已发送的数据超过这个时间没有被确认就断开连接
+    int keepAlive;          // SO_KEEPALIVE
+    int keepIdle;           // TCP_KEEPIDLE，秒
+    int keepInterval;       // TCP_KEEPINTVL，秒
+    int keepCount;          // TCP_KEEPCNT
+    int lingerSeconds;      // SO_LINGER，0 表示 close 时直接发送 RST
+};
+
+/**
+ * 监听 socket 的选项，由 TcpServer 交给 Acceptor，在 listen 时设置
+*/
+struct ListenOptions {
+    static const int kDefaultBacklog = 1024;
+
+    ListenOptions()
+        : backlog(kDefaultBacklog),
+          deferAcceptSeconds(0),
+          fastOpenQueueLen(0) {}
+
+    int backlog;                // listen 的 backlog，实际生效的值不超过 net.core.somaxconn
+    int deferAcceptSeconds;     // TCP_DEFER_ACCEPT，大于 0 时客户端发来第一个请求的数据以后 accept 才会返回
+    int fastOpenQueueLen;       // TCP_FASTOPEN，大于 0 时开启服务端的 Fast Open，值为等待 accept 的 TFO 连接的队列长度
+};
+
+}   // namespace mymuduo
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _STRINGPIECE_H
+#define _STRINGPIECE_H
+
+#include <string>
+#include <ostream>
+#include <string.h>
+
+namespace mymuduo {
+
+/**
+ * 一段只读内存的引用（指针 + 长度），不拥有数据，也不拷贝数据
+ * 引用的内存失效后 StringPiece 也随之失效，需要保留数据时用 asString() 显式拷贝一份
+*/
+class StringPiece {
+public:
+    StringPiece() : ptr_(nullptr), length_(0) {}
+    StringPiece(const char *str) : ptr_(str), length_(::strlen(str)) {}
+    StringPiece(const std::string &str) : ptr_(str.data()), length_(str.size()) {}
+    StringPiece(const void *data, size_t len) : ptr_(static_cast<const char *>(data)), length_(len) {}
+
+    const char *data() const { return ptr_; }
+    size_t size() const { return length_; }
+    bool empty() const { return length_ == 0; }
+
+    std::string asString() const { return std::string(ptr_, length_); }
+
+    bool operator==(const StringPiece &rhs) const {
+        return length_ == rhs.length_ && ::memcmp(ptr_, rhs.ptr_, length_) == 0;
+    }
+    bool operator!=(const StringPiece &rhs) const { return !(*this == rhs); }
+
+private:
+    const char *ptr_;
+    size_t length_;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const StringPiece &piece) {
+    return os.write(piece.data(), piece.size());
+}
+
+}   // namespace mymuduo
+
+#endif
@@ -0,0 +1,186 @@
+#include "StringSearch.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MYMUDUO_X86_SIMD 1
+#endif
+
+namespace mymuduo {
+
+namespace search {
+
+namespace {
+
+using FindByteFunc = const char *(*)(const char *, const char *, char);
+using FindSequenceFunc = const char *(*)(const char *, const char *, const char *, size_t);
+
+const char *findByteScalar(const char *begin, const char *end, char c) {
+    for(const char *p = begin; p < end; ++p) {
+        if(*p == c) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+const char *findSequenceScalar(const char *begin, const char *end, const char *seq, size_t len) {
+    if(len == 0) {
+        return begin;
+    }
+    const char *p = begin;
+    while(static_cast<size_t>(end - p) >= len) {
+        p = static_cast<const char *>(::memchr(p, seq[0], end - p - len + 1));
+        if(p == nullptr) {
+            return nullptr;
+        }
+        if(::memcmp(p + 1, seq + 1, len - 1) == 0) {
+            return p;
+        }
+        ++p;
+    }
+    return nullptr;
+}
+
+#ifdef MYMUDUO_X86_SIMD
+
+// 单字节查找每次处理 4 个向量，把比较结果 or 在一起，只有命中时才去定位具体的字节
+__attribute__((target("sse2")))
+const char *findByteSse2(const char *begin, const char *end, char c) {
+    const __m128i needle = _mm_set1_epi8(c);
+    const char *p = begin;
+    for(; end - p >= 64; p += 64) {
+        __m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), needle);
+        __m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16)), needle);
+        __m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 32)), needle);
+        __m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 48)), needle);
+        if(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(e0, e1), _mm_or_si128(e2, e3))) != 0) {
+            break;
+        }
+    }
+    for(; end - p >= 16; p += 16) {
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), needle));
+        if(mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findByteScalar(p, end, c);
+}
+
+__attribute__((target("avx2")))
+const char *findByteAvx2(const char *begin, const char *end, char c) {
+    const __m256i needle = _mm256_set1_epi8(c);
+    const char *p = begin;
+    for(; end - p >= 128; p += 128) {
+        __m256i e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)), needle);
+        __m256i e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32)), needle);
+        __m256i e2 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 64)), needle);
+        __m256i e3 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 96)), needle);
+        if(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(e0, e1), _mm256_or_si256(e2, e3))) != 0) {
+            break;
+        }
+    }
+    for(; end - p >= 32; p += 32) {
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)), needle));
+        if(mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findByteSse2(p, end, c);
+}
+
+/**
+ * 每次比较一个块：候选位置 i 需要满足 p[i] == seq[0] 且 p[i + len - 1] == seq[len - 1]
+ * 两个条件都用一次向量比较得到位掩码，只对同时命中的位置做 memcmp 确认中间的字节
+*/
+__attribute__((target("sse2")))
+const char *findSequenceSse2(const char *begin, const char *end, const char *seq, size_t len) {
+    if(len == 0 || static_cast<size_t>(end - begin) < len) {
+        return len == 0 ? begin : nullptr;
+    }
+    const __m128i first = _mm_set1_epi8(seq[0]);
+    const __m128i last = _mm_set1_epi8(seq[len - 1]);
+    const char *limit = end - len + 1;     // 候选起始位置的上界（不含）
+    const char *p = begin;
+    for(; limit - p >= 16; p += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + len - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while(mask != 0) {
+            int bit = __builtin_ctz(mask);
+            if(len <= 2 || ::memcmp(p + bit + 1, seq + 1, len - 2) == 0) {
+                return p + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return findSequenceScalar(p, end, seq, len);
+}
+
+__attribute__((target("avx2")))
+const char *findSequenceAvx2(const char *begin, const char *end, const char *seq, size_t len) {
+    if(len == 0 || static_cast<size_t>(end - begin) < len) {
+        return len == 0 ? begin : nullptr;
+    }
+    const __m256i first = _mm256_set1_epi8(seq[0]);
+    const __m256i last = _mm256_set1_epi8(seq[len - 1]);
+    const char *limit = end - len + 1;
+    const char *p = begin;
+    for(; limit - p >= 32; p += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + len - 1));
+        unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        while(mask != 0) {
+            int bit = __builtin_ctz(mask);
+            if(len <= 2 || ::memcmp(p + bit + 1, seq + 1, len - 2) == 0) {
+                return p + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return findSequenceSse2(p, end, seq, len);
+}
+
+#endif  // MYMUDUO_X86_SIMD
+
+struct Impl {
+    FindByteFunc findByte;
+    FindSequenceFunc findSequence;
+    const char *name;
+};
+
+// 只在第一次使用时检测一次 CPU 特性
+const Impl &impl() {
+    static const Impl selected = []() -> Impl {
+#ifdef MYMUDUO_X86_SIMD
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")) {
+            return Impl{ findByteAvx2, findSequenceAvx2, "avx2" };
+        }
+        if(__builtin_cpu_supports("sse2")) {
+            return Impl{ findByteSse2, findSequenceSse2, "sse2" };
+        }
+#endif
+        return Impl{ findByteScalar, findSequenceScalar, "scalar" };
+    }();
+    return selected;
+}
+
+}   // namespace
+
+const char *findByte(const char *begin, const char *end, char c) {
+    return impl().findByte(begin, end, c);
+}
+
+const char *findSequence(const char *begin, const char *end, const char *seq, size_t len) {
+    return impl().findSequence(begin, end, seq, len);
+}
+
+const char *implName() {
+    return impl().name;
+}
+
+}   // namespace search
+
+}   // namespace mymuduo
@@ -0,0 +1,24 @@
+#ifndef _STRINGSEARCH_H
+#define _STRINGSEARCH_H
+
+#include <stddef.h>
+
+namespace mymuduo {
+
+/**
+ * Buffer 使用的查找函数，x86 上运行时根据 CPU 选择 AVX2 / SSE2 实现，其它平台使用标量实现
+ * 在 [begin, end) 中查找，返回第一个匹配的起始地址，找不到返回 nullptr
+*/
+namespace search {
+
+const char *findByte(const char *begin, const char *end, char c);
+const char *findSequence(const char *begin, const char *end, const char *seq, size_t len);
+
+// 当前使用的实现：avx2 / sse2 / scalar
+const char *implName();
+
+}   // namespace search
+
+}   // namespace mymuduo
+
+#endif
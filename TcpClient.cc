@@ -9,8 +9,9 @@ using namespace std::placeholders;
 namespace mymuduo {
 
 namespace detail {
+    // TcpClient 析构后它的连接关闭时调用，只需要销毁连接
     void removeConnection(EventLoop *loop, const TcpConnectionPtr &conn) {
-
+        loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
     }
 }
 
@@ -112,10 +113,14 @@ void TcpClient::newConnection(int sockfd) {
     InetAddress localAddr(localaddr);
 
     TcpConnectionPtr conn(new TcpConnection(loop_, connName, sockfd, localAddr, peerAddr));
-    conn->setConnectionCallback(connectionCallback_);
-    conn->setMessageCallback(messageCallback_);
-    conn->setWriteCompleteCallback(writeCompleteCallback_);
-    conn->setCloseCallback(std::bind(&TcpClient::removeConnection, this, _1));
+    conn->setSocketOptions(socketOptions_);
+    // 一次性生成连接的回调表，不需要逐个设置（每次设置都会复制一份）
+    std::shared_ptr<TcpConnectionCallbacks> callbacks(std::make_shared<TcpConnectionCallbacks>());
+    callbacks->connectionCallback = connectionCallback_;
+    callbacks->messageCallback = messageCallback_;
+    callbacks->writeCompleteCallback = writeCompleteCallback_;
+    callbacks->closeCallback = std::bind(&TcpClient::removeConnection, this, _1);
+    conn->setCallbacks(callbacks);
 
     {
         std::unique_lock<std::mutex> lock(mutex_);
@@ -46,6 +46,11 @@ public:
         writeCompleteCallback_ = std::move(cb);
     }
 
+    // 连接 socket 的选项，在下一次连接建立时生效
+    void setSocketOptions(const SocketOptions &options) {
+        socketOptions_ = options;
+    }
+
 private:
     void newConnection(int sockfd);
     void removeConnection(const TcpConnectionPtr &conn);
@@ -57,6 +62,7 @@ private:
     ConnectionCallback connectionCallback_;
     MessageCallback messageCallback_;
     WriteCompleteCallback writeCompleteCallback_;
+    SocketOptions socketOptions_;
 
     bool retry_;
     bool connect_;
@@ -8,9 +8,17 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <linux/errqueue.h>
+#include <limits.h>
 #include <strings.h>
 #include <string>
+#include <algorithm>
 
 namespace mymuduo {
 
@@ -21,34 +29,115 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop) {
     return loop;
 }
 
+// 没有设置回调表的连接共享同一张空表
+static const TcpConnectionCallbacksPtr &defaultCallbacks() {
+    static const TcpConnectionCallbacksPtr callbacks(std::make_shared<TcpConnectionCallbacks>());
+    return callbacks;
+}
+
+TcpConnection::TcpConnection(EventLoop *loop,
+                    const std::string &nameArg,
+                    int sockfd,
+                    const InetAddress &localAddr,
+                    const InetAddress &peerAddr)
+        : TcpConnection(loop, 0, nullptr, nameArg, sockfd, localAddr, peerAddr) {}
+
+TcpConnection::TcpConnection(EventLoop *loop,
+                    uint64_t id,
+                    const std::shared_ptr<const std::string> &namePrefix,
+                    int sockfd,
+                    const InetAddress &localAddr,
+                    const InetAddress &peerAddr)
+        : TcpConnection(loop, id, namePrefix, std::string(), sockfd, localAddr, peerAddr) {}
+
 TcpConnection::TcpConnection(EventLoop *loop,
+                    uint64_t id,
+                    const std::shared_ptr<const std::string> &namePrefix,
                     const std::string &nameArg,
                     int sockfd,
                     const InetAddress &localAddr,
-                    const InetAddress &peerAddr) 
+                    const InetAddress &peerAddr)
         : loop_(CheckLoopNotNull(loop)),
+          id_(id),
+          namePrefix_(namePrefix),
           name_(nameArg),
           state_(kConnecting),
           reading_(true),
-          socket_(new Socket(sockfd)),
-          channel_(new Channel(loop, sockfd)),
+          socket_(sockfd),
+          channel_(loop, sockfd),
           localAddr_(localAddr),
           peerAddr_(peerAddr),
-          highWaterMark_(64 * 1024 * 1024)  // 64M
+          callbacks_(defaultCallbacks()),
+          ownedCallbacks_(nullptr),
+          highWaterMark_(64 * 1024 * 1024),  // 64M
+          lowWaterMark_(0),
+          aboveLowWaterMark_(false),
+          backpressureHigh_(0),
+          backpressureLow_(0),
+          backpressurePaused_(false),
+          writeTimeout_(0.0),
+          maxOutputBytes_(0),
+          writeTimerArmed_(false),
+          evicted_(false),
+          outputAborted_(false),
+          contextType_(nullptr),
+          followingBytes_(0),
+          coalescing_(false),
+          coalesceThreshold_(kDefaultCoalesceThreshold),
+          flushScheduled_(false),
+          relaying_(false),
+          relayPipeBytes_(0),
+          trafficConnected_(false),
+          zeroCopy_(false),
+          zeroCopyThreshold_(kDefaultZeroCopyThreshold),
+          zeroCopySeq_(0)
 {
     // 下面给 Channel 设置相应的回调函数，当 poller 监听到 channel 感兴趣的事件，就会调用 channel 对应的回调
-    channel_->setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
-    channel_->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
-    channel_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
+    // 只捕获 this 的 lambda 可以放进 std::function 内部的小缓冲区，不会为每个回调分配内存（std::bind 成员函数会）
+    channel_.setReadCallback([this](Timestamp receiveTime) { handleRead(receiveTime); });
+    channel_.setWriteCallback([this]() { handleWrite(); });
+    channel_.setCloseCallback([this]() { handleClose(); });
+    channel_.setErrorCallback([this]() { handleError(); });
 
-    LOG_INFO << "TcpConnection::ctor[" << name_ << "] at fd = " << sockfd;
-    socket_->setKeepAlive(true);
+    relayPipe_[0] = relayPipe_[1] = -1;
+
+    LOG_INFO << "TcpConnection::ctor[" << name() << "] at fd = " << sockfd;
+    socket_.setKeepAlive(true);
 }
 
 
 TcpConnection::~TcpConnection() {
-    LOG_INFO << "TcpConnection::dtor[" << name_ << "] at fd = " << channel_->fd() << ", state = " << state_;
+    LOG_INFO << "TcpConnection::dtor[" << name() << "] at fd = " << channel_.fd() << ", state = " << state_;
+    for(const FileRegion &region : pendingFiles_) {
+        ::close(region.fd);
+    }
+    closeRelayPipe();
+}
+
+const std::string &TcpConnection::name() const {
+    std::call_once(nameOnce_, [this]() {
+        if(namePrefix_) {
+            name_ = *namePrefix_ + "#" + std::to_string(id_);
+        }
+    });
+    return name_;
+}
+
+TcpConnectionCallbacks *TcpConnection::mutableCallbacks() {
+    if(ownedCallbacks_ == nullptr) {
+        std::shared_ptr<TcpConnectionCallbacks> copy(std::make_shared<TcpConnectionCallbacks>(*callbacks_));
+        ownedCallbacks_ = copy.get();
+        callbacks_ = std::move(copy);
+    }
+    return ownedCallbacks_;
+}
+
+void TcpConnection::setSocketOptions(const SocketOptions &options) {
+    socket_.applyOptions(options);
+}
+
+bool TcpConnection::getTcpInfo(TcpInfo *info) const {
+    return socket_.getTcpInfo(info);
 }
 
 void TcpConnection::send(const std::string &buf) {
@@ -56,65 +145,796 @@ void TcpConnection::send(const std::string &buf) {
         if(loop_->isInLoopThread()) {
             sendInLoop(buf.c_str(), buf.size());
         } else {
-            sendMsg.clear();
-            sendMsg = buf;
-            sendMsgLen = sendMsg.size();
+            // 拷贝一份交给任务持有，调用方的 buf 在 send 返回后就可以修改或释放
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, shared_from_this(), buf));
+        }
+    }
+}
+
+void TcpConnection::send(std::string &&buf) {
+    if(state_ == kConnected) {
+        if(loop_->isInLoopThread()) {
+            sendInLoop(buf.data(), buf.size());
+        } else {
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, shared_from_this(), std::move(buf)));
+        }
+    }
+}
+
+void TcpConnection::send(Buffer *buf) {
+    if(state_ == kConnected) {
+        if(loop_->isInLoopThread()) {
+            sendInLoop(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        } else {
+            // 把 buf 的内存移动进任务，调用方拿回的是一个不持有内存的空 Buffer
+            loop_->runInLoop(std::bind(&TcpConnection::sendBufferInLoop, shared_from_this(), std::move(*buf)));
+        }
+    }
+}
+
+void TcpConnection::sendBufferInLoop(const Buffer &buf) {
+    sendInLoop(buf.peek(), buf.readableBytes());
+}
+
+void TcpConnection::send(const void *data, size_t len) {
+    if(state_ == kConnected) {
+        if(loop_->isInLoopThread()) {
+            sendInLoop(data, len);
+        } else {
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, shared_from_this(),
+                                       std::string(static_cast<const char *>(data), len)));
+        }
+    }
+}
 
-            loop_->runInLoop(std::bind(&TcpConnection::sendInLoop, this, sendMsg.c_str(), sendMsgLen));
+void TcpConnection::send(const std::vector<StringPiece> &slices) {
+    if(state_ == kConnected) {
+        if(loop_->isInLoopThread()) {
+            sendSlicesInLoop(slices.data(), slices.size());
+        } else {
+            // 跨线程时片段指向的内存可能在 sendInLoop 执行前失效，只能拼接成一份拷贝交给 loop 线程
+            std::string message;
+            for(const StringPiece &slice : slices) {
+                message.append(slice.data(), slice.size());
+            }
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, shared_from_this(), std::move(message)));
         }
     }
 }
 
+void TcpConnection::sendStringInLoop(const std::string &message) {
+    sendInLoop(message.data(), message.size());
+}
+
+void TcpConnection::sendInLoop(const void *data, size_t len) {
+    StringPiece slice(data, len);
+    sendSlicesInLoop(&slice, 1);
+}
+
 /**
  * 发送数据：应用写的快，而内核发送数据慢，需要把待发送的数据写入缓冲区，然后设置水位回调
+ * outputBuffer_ 中已有的数据和新的数据片段通过一次 writev 发送，只把内核没有接收的部分拷贝到 outputBuffer_ 中
 */
-void TcpConnection::sendInLoop(const void *data, size_t len) {
-    ssize_t nwrote = 0;
-    size_t remaining = len;
-    bool faultError = false;
+void TcpConnection::sendSlicesInLoop(const StringPiece *slices, size_t count) {
+    size_t len = 0;
+
+    for(size_t i = 0; i < count; i++) {
+        len += slices[i].size();
+    }
 
-    LOG_INFO << "send data = " << (const char *)data << ", len = " << len;
+    LOG_INFO << "send data len = " << len << ", slices = " << count;
     // 如果之前调用过该 TcpConnection 的 shutdown，就不能再发送了
-    if(state_ == kDisconnected) {
+    if(state_ == kDisconnected || outputAborted_) {
         LOG_ERROR << "disconnected, give up writing!";
         return ;
     }
+    recordMessageOut();
 
-    // channel 第一次开始写数据，而且发送缓冲区没有待发送数据
-    if(!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
-        nwrote = ::write(channel_->fd(), data, len);
-        if(nwrote >= 0) {
-            remaining = len - nwrote;
-            if(remaining == 0 && writeCompleteCallback_) {
-                // 如果一次性就把数据全部发送完了，就不用再给 channel 设置 EPOLLOUT 事件了
-                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
-            }
-        } else {    // nworte < 0
-            nwrote = 0;
-            if(errno != EWOULDBLOCK) {
-                LOG_ERROR << "TcpConnection::sendInLoop error";
-
-                if(errno == EPIPE || errno == ECONNRESET) {     // SIGPIPE  RESET
-                    faultError = true;
-                }
+    // 前面还有文件没有发送完，新数据只能排在文件后面，等 handleWrite 发送
+    if(!pendingFiles_.empty()) {
+        const size_t bufferedLen = bufferedOutputBytes();
+        if(bufferedLen + len >= highWaterMark_ && bufferedLen < highWaterMark_ && callbacks_->highWaterMarkCallback) {
+            loop_->queueInLoop(std::bind(callbacks_->highWaterMarkCallback, shared_from_this(), bufferedLen + len));
+        }
+        Buffer &following = pendingFiles_.back().following;
+        for(size_t i = 0; i < count; i++) {
+            following.append(slices[i].data(), slices[i].size());
+        }
+        followingBytes_ += len;
+        outputAppended();
+        return ;
+    }
+
+    // 写合并：本轮事件循环中的数据先累积在 outputBuffer_ 中，处理完所有活跃的 channel 后统一发送
+    if(coalescing_) {
+        const size_t bufferedLen = outputBuffer_.readableBytes();
+        if(bufferedLen + len >= highWaterMark_ && bufferedLen < highWaterMark_ && callbacks_->highWaterMarkCallback) {
+            loop_->queueInLoop(std::bind(callbacks_->highWaterMarkCallback, shared_from_this(), bufferedLen + len));
+        }
+        for(size_t i = 0; i < count; i++) {
+            outputBuffer_.append(slices[i].data(), slices[i].size());
+        }
+        outputAppended();
+        if(channel_.isWriting()) {
+            return ;    // 内核发送缓冲区已满，等 handleWrite
+        }
+        if(outputBuffer_.readableBytes() >= coalesceThreshold_) {
+            // 已经登记的 flushCoalesced 仍然会执行，flushScheduled_ 保持不变
+            writeSlicesInLoop(nullptr, 0, 0);
+        } else if(!flushScheduled_) {
+            flushScheduled_ = true;
+            loop_->runAtEndOfIteration(std::bind(&TcpConnection::flushCoalesced, shared_from_this()));
+        }
+        return ;
+    }
+
+    writeSlicesInLoop(slices, count, len);
+}
+
+void TcpConnection::setWriteCoalescing(bool on, size_t threshold) {
+    coalescing_ = on;
+    coalesceThreshold_ = threshold;
+}
+
+void TcpConnection::flushCoalesced() {
+    flushScheduled_ = false;
+    if(state_ == kDisconnected || channel_.isWriting()) {
+        return ;
+    }
+    if(outputBuffer_.readableBytes() == 0) {
+        // 数据已经因为超过阈值提前发送完了，补上等待这次 flush 的 shutdown
+        if(state_ == kDisconnecting) {
+            shutdownInLoop();
+        }
+        return ;
+    }
+    writeSlicesInLoop(nullptr, 0, 0);
+}
+
+void TcpConnection::writeSlicesInLoop(const StringPiece *slices, size_t count, size_t len) {
+    ssize_t nwrote = 0;
+    bool faultError = false;
+
+    const size_t oldLen = outputBuffer_.readableBytes();
+    if(oldLen + len == 0) {
+        return ;
+    }
+
+    // 发送缓冲区中的旧数据必须排在新数据前面，所以它总是第一个 iovec
+    struct iovec vec[64];
+    int iovcnt = 0;
+    if(oldLen > 0) {
+        vec[iovcnt].iov_base = const_cast<char *>(outputBuffer_.peek());
+        vec[iovcnt].iov_len = oldLen;
+        iovcnt++;
+    }
+    for(size_t i = 0; i < count && iovcnt < 64; i++) {
+        if(!slices[i].empty()) {
+            vec[iovcnt].iov_base = const_cast<char *>(slices[i].data());
+            vec[iovcnt].iov_len = slices[i].size();
+            iovcnt++;
+        }
+    }
+
+    nwrote = ::writev(channel_.fd(), vec, iovcnt);
+    recordWrite(nwrote, errno);
+    if(nwrote < 0) {
+        nwrote = 0;
+        if(errno != EWOULDBLOCK) {
+            LOG_ERROR << "TcpConnection::writeSlicesInLoop error";
+
+            if(errno == EPIPE || errno == ECONNRESET) {     // SIGPIPE  RESET
+                faultError = true;
             }
         }
     }
 
-    // 说明当前这次 write 并没有把全部数据发送出去，那么剩余的数据就要保存到缓冲区当中，然后给 Channel 注册 EPOLLOUT 事件
+    if(faultError) {
+        return ;
+    }
+
+    // 先消耗 outputBuffer_ 中的旧数据
+    size_t written = static_cast<size_t>(nwrote);
+    size_t fromBuffer = std::min(written, oldLen);
+    outputBuffer_.retrieve(fromBuffer);
+    written -= fromBuffer;
+    if(fromBuffer > 0) {
+        outputRetrieved();
+    }
+
+    // 说明当前这次 writev 并没有把全部数据发送出去，那么剩余的数据就要保存到缓冲区当中，然后给 Channel 注册 EPOLLOUT 事件
     // 之后 Poller 发送 TCP 的发送缓冲区中有内容需要发送，就会通知相应的 sockfd，然后调用 channel 的 handleWrite 方法
     // 也就是调用 TcpConnection::handleWrite 方法，把发送缓冲区中的数据全部发送
-    if(!faultError && remaining > 0) {
-        // 目前发送缓冲区剩余的待发送数据的长度
-        size_t oldLen = outputBuffer_.readableBytes();
-        if(oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_) {
-            loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+    const size_t remaining = len - written;
+    if(remaining > 0) {
+        size_t bufferedLen = outputBuffer_.readableBytes();
+        if(bufferedLen + remaining >= highWaterMark_ && bufferedLen < highWaterMark_ && callbacks_->highWaterMarkCallback) {
+            loop_->queueInLoop(std::bind(callbacks_->highWaterMarkCallback, shared_from_this(), bufferedLen + remaining));
+        }
+        for(size_t i = 0; i < count; i++) {
+            if(written >= slices[i].size()) {
+                written -= slices[i].size();
+            } else {
+                outputBuffer_.append(slices[i].data() + written, slices[i].size() - written);
+                written = 0;
+            }
+        }
+        outputAppended();
+    }
+
+    if(outputBuffer_.readableBytes() > 0) {
+        // 注册 channel 的写事件
+        startWriting();
+    } else {
+        // 如果一次性就把数据全部发送完了，就不用再给 channel 设置 EPOLLOUT 事件了
+        handleOutputDrained();
+    }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t length) {
+    if(state_ == kConnected) {
+        int dupfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if(dupfd < 0) {
+            LOG_ERROR << "TcpConnection::sendFile dup fd = " << fd << " error : " << errno;
+            return ;
+        }
+        loop_->runInLoop(std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), dupfd, offset, length));
+    }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length) {
+    if(state_ == kDisconnected || outputAborted_) {
+        LOG_ERROR << "disconnected, give up sending file!";
+        ::close(fd);
+        return ;
+    }
+
+    recordMessageOut();
+    pendingFiles_.emplace_back(fd, offset, length);
+
+    // 前面没有待发送的数据，直接尝试发送，否则等 handleWrite 按顺序发送
+    if(!channel_.isWriting() && outputBuffer_.readableBytes() == 0 && pendingFiles_.size() == 1) {
+        if(drainPendingFiles()) {
+            handleOutputDrained();
+            return ;
+        }
+        if(outputAborted_) {
+            return ;
+        }
+    }
+
+    startWriting();
+}
+
+void TcpConnection::send(const std::shared_ptr<const std::string> &payload) {
+    if(state_ == kConnected) {
+        if(loop_->isInLoopThread()) {
+            sendPayloadInLoop(payload);
+        } else {
+            loop_->runInLoop(std::bind(&TcpConnection::sendPayloadInLoop, shared_from_this(), payload));
+        }
+    }
+}
+
+bool TcpConnection::enableZeroCopy(size_t threshold) {
+    zeroCopyThreshold_ = threshold;
+    zeroCopy_ = socket_.setZeroCopy(true);
+    return zeroCopy_;
+}
+
+void TcpConnection::sendPayloadInLoop(const std::shared_ptr<const std::string> &payload) {
+    if(state_ == kDisconnected || outputAborted_) {
+        LOG_ERROR << "disconnected, give up writing!";
+        return ;
+    }
+
+#ifdef MSG_ZEROCOPY
+    // 只有前面没有排队的数据时才能直接交给内核，否则会打乱发送顺序
+    if(zeroCopy_ && payload->size() >= zeroCopyThreshold_ && !channel_.isWriting()
+        && outputBuffer_.readableBytes() == 0 && pendingFiles_.empty()) {
+        ssize_t n = ::send(channel_.fd(), payload->data(), payload->size(), MSG_ZEROCOPY);
+        recordWrite(n, errno);
+        if(n > 0) {
+            // 内核会引用 payload 的内存页，收到完成通知之前不能释放
+            ZeroCopyPayload pinned = { zeroCopySeq_++, payload };
+            zeroCopyPayloads_.push_back(pinned);
+            if(static_cast<size_t>(n) == payload->size()) {
+                recordMessageOut();
+                handleOutputDrained();
+            } else {
+                // 剩下的部分走普通的拷贝路径
+                sendInLoop(payload->data() + n, payload->size() - n);
+            }
+            return ;
+        } else if(errno != EWOULDBLOCK && errno != ENOBUFS) {
+            // ENOBUFS 表示超过了 optmem 限制，和 EWOULDBLOCK 一样退回到拷贝路径
+            LOG_ERROR << "TcpConnection::sendPayloadInLoop error : " << errno;
+            if(errno == EPIPE || errno == ECONNRESET) {
+                return ;
+            }
+        }
+    }
+#endif
+
+    sendInLoop(payload->data(), payload->size());
+}
+
+bool TcpConnection::handleZeroCopyCompletions() {
+    bool completed = false;
+    while(true) {
+        char control[128];
+        struct msghdr msg;
+        ::bzero(&msg, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if(::recvmsg(channel_.fd(), &msg, MSG_ERRQUEUE) < 0) {
+            break;      // EAGAIN：错误队列已经读空
+        }
+
+        for(struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+            if(!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                && !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+                continue;
+            }
+            const struct sock_extended_err *serr = reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(cm));
+            if(serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+
+            // 完成通知覆盖序号区间 [ee_info, ee_data]，序号是 32 位回绕的
+            const uint32_t lo = serr->ee_info;
+            const uint32_t hi = serr->ee_data;
+            zeroCopyPayloads_.erase(
+                std::remove_if(zeroCopyPayloads_.begin(), zeroCopyPayloads_.end(),
+                    [lo, hi](const ZeroCopyPayload &p) { return p.seq - lo <= hi - lo; }),
+                zeroCopyPayloads_.end());
+            completed = true;
+        }
+    }
+    return completed;
+}
+
+void TcpConnection::startRelay(const TcpConnectionPtr &peer) {
+    loop_->assertInLoopThread();
+    if(peer->getLoop() != loop_) {
+        LOG_ERROR << "TcpConnection::startRelay [" << name() << "] and [" << peer->name() << "] are in different loops";
+        return ;
+    }
+
+    setupRelay(peer);
+    peer->setupRelay(shared_from_this());
+
+    // 开启转发之前已经读到的数据，先按拷贝的方式转发
+    if(inputBuffer_.readableBytes() > 0) {
+        peer->sendInLoop(inputBuffer_.peek(), inputBuffer_.readableBytes());
+        inputBuffer_.retrieveAll();
+    }
+    if(peer->inputBuffer_.readableBytes() > 0) {
+        sendInLoop(peer->inputBuffer_.peek(), peer->inputBuffer_.readableBytes());
+        peer->inputBuffer_.retrieveAll();
+    }
+}
+
+void TcpConnection::setupRelay(const TcpConnectionPtr &peer) {
+    relayPeer_ = peer;
+    relaying_ = true;
+    if(relayPipe_[0] < 0 && ::pipe2(relayPipe_, O_NONBLOCK | O_CLOEXEC) < 0) {
+        LOG_ERROR << "TcpConnection::setupRelay pipe2 error : " << errno << ", fall back to buffered relay";
+        relayPipe_[0] = relayPipe_[1] = -1;
+    }
+}
+
+void TcpConnection::closeRelayPipe() {
+    if(relayPipe_[0] >= 0) {
+        ::close(relayPipe_[0]);
+        ::close(relayPipe_[1]);
+        relayPipe_[0] = relayPipe_[1] = -1;
+    }
+}
+
+void TcpConnection::handleRelayRead(const TcpConnectionPtr &peer) {
+    const size_t budget = loop_->readBudget();
+    if(peer && peer->relayPipe_[1] >= 0) {
+        // socket -> peer 的 pipe，数据不经过用户态
+        const size_t limit = budget > 0 ? std::min<size_t>(budget, 65536) : 65536;
+        ssize_t n = ::splice(channel_.fd(), nullptr, peer->relayPipe_[1], nullptr,
+                             limit, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        recordRead(n, n < 0 ? errno : 0);
+        if(budget > 0 && n == static_cast<ssize_t>(budget)) {
+            recordReadBudgetHit();
+        }
+        if(n > 0) {
+            peer->relayPipeBytes_ += n;
+            peer->flushRelayPipe();
+        } else if(n == 0) {
+            handleClose();
+            return ;
+        } else if(errno == EINVAL && peer->relayPipeBytes_ == 0) {
+            // 这种 fd 组合不支持 splice，之后走拷贝转发
+            LOG_ERROR << "TcpConnection::handleRelayRead splice not supported, fall back to buffered relay";
+            peer->closeRelayPipe();
+        } else if(errno != EAGAIN) {
+            LOG_ERROR << "TcpConnection::handleRelayRead error : " << errno;
+            abortRelay();
+            return ;
+        }
+    }
+
+    if(!peer || peer->relayPipe_[1] < 0) {
+        int savedErrno = 0;
+        ssize_t n = inputBuffer_.readFd(channel_.fd(), &savedErrno, budget > 0 ? budget : SIZE_MAX);
+        recordRead(n, savedErrno);
+        if(budget > 0 && n == static_cast<ssize_t>(budget)) {
+            recordReadBudgetHit();
+        }
+        if(n > 0) {
+            // peer 出错、关闭或者已经析构以后没有地方可以转发，读到的数据直接丢弃，继续读取是为了发现当前连接的关闭
+            if(peer && !peer->outputAborted_ && peer->state_ != kDisconnected) {
+                peer->sendInLoop(inputBuffer_.peek(), inputBuffer_.readableBytes());
+            }
+            inputBuffer_.retrieveAll();
+        } else if(n == 0) {
+            handleClose();
+            return ;
+        } else if(savedErrno != EAGAIN) {
+            LOG_ERROR << "TcpConnection::handleRelayRead error : " << savedErrno;
+            abortRelay();
+            return ;
+        }
+    }
+
+    // peer 发不出去了，暂停读取当前连接，等 peer 的积压数据发送完后再恢复
+    if(peer && peer->hasPendingOutput() && channel_.isReading()) {
+        channel_.disableReading();
+    }
+}
+
+bool TcpConnection::flushRelayPipe() {
+    // outputBuffer_ 和文件中的数据排在转发的数据前面
+    if(outputBuffer_.readableBytes() > 0 || !pendingFiles_.empty()) {
+        if(relayPipeBytes_ > 0) {
+            startWriting();
+        }
+        return relayPipeBytes_ == 0;
+    }
+
+    while(relayPipeBytes_ > 0) {
+        ssize_t n = ::splice(relayPipe_[0], nullptr, channel_.fd(), nullptr,
+                             relayPipeBytes_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        recordWrite(n, n < 0 ? errno : 0);
+        if(n > 0) {
+            relayPipeBytes_ -= n;
+        } else if(n < 0 && errno != EAGAIN) {
+            // EPIPE / ECONNRESET 等，重试也不会成功
+            LOG_ERROR << "TcpConnection::flushRelayPipe error : " << errno;
+            abortRelay();
+            return false;
+        } else {
+            break;
+        }
+    }
+
+    if(relayPipeBytes_ > 0) {
+        startWriting();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 转发中的连接出错（如对端发送了 RST）：丢弃 pipe 中转发给当前连接的数据并关闭当前连接
+ * 关闭时 handleClose 会让 peer 发送完已经收到的数据后关闭写端，之后 peer 读到的数据不再转发（见 handleRelayRead）
+*/
+void TcpConnection::abortRelay() {
+    closeRelayPipe();
+    relayPipeBytes_ = 0;
+    abortOutput();
+}
+
+bool TcpConnection::sendFileRegion() {
+    FileRegion &region = pendingFiles_.front();
+    while(region.remaining > 0) {
+        ssize_t n = ::sendfile(channel_.fd(), region.fd, &region.offset, region.remaining);
+        recordWrite(n, n < 0 ? errno : 0);
+        if(n > 0) {
+            region.remaining -= n;
+        } else if(n == 0) {
+            // 文件比请求的区域短，对端按长度收不到完整的数据，不能接着发送后面的数据
+            LOG_ERROR << "TcpConnection::sendFileRegion reach EOF, " << region.remaining << " bytes not sent";
+            abortOutput();
+            return false;
+        } else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            return false;
+        } else {
+            LOG_ERROR << "TcpConnection::sendFileRegion error : " << errno;
+            abortOutput();
+            return false;
+        }
+    }
+
+    // 文件区域发送完毕，排在它后面的数据成为新的 outputBuffer_
+    ::close(region.fd);
+    followingBytes_ -= region.following.readableBytes();
+    outputBuffer_.swap(region.following);
+    pendingFiles_.pop_front();
+    outputAppended();
+    return true;
+}
+
+/**
+ * 待发送的数据已经不能完整、按顺序地发出（文件被截断、sendfile 出错等）：
+ * 丢弃所有待发送的数据，之后的 send 也直接丢弃，然后关闭连接，不会再回调 writeCompleteCallback
+*/
+void TcpConnection::abortOutput() {
+    outputAborted_ = true;
+    for(const FileRegion &region : pendingFiles_) {
+        ::close(region.fd);
+    }
+    pendingFiles_.clear();
+    followingBytes_ = 0;
+    outputBuffer_.retrieveAll();
+    if(channel_.isWriting()) {
+        channel_.disableWriting();
+    }
+    cancelWriteDeadline();
+    handleError();
+    forceClose();
+}
+
+bool TcpConnection::drainPendingFiles() {
+    while(outputBuffer_.readableBytes() == 0 && !pendingFiles_.empty()) {
+        if(!sendFileRegion()) {
+            return false;
+        }
+        if(outputBuffer_.readableBytes() > 0) {
+            int savedErrno = 0;
+            ssize_t n = outputBuffer_.writeFd(channel_.fd(), &savedErrno);
+            recordWrite(n, savedErrno);
+            if(n > 0) {
+                outputBuffer_.retrieve(n);
+            }
+        }
+        outputRetrieved();
+    }
+    return outputBuffer_.readableBytes() == 0 && pendingFiles_.empty();
+}
+
+void TcpConnection::handleOutputDrained() {
+    // 转发的数据还在 pipe 中，等 handleWrite 继续发送
+    if(relayPipeBytes_ > 0) {
+        startWriting();
+        return ;
+    }
+
+    // 积压的数据发送完了，恢复读取转发给当前连接的 peer
+    if(relaying_) {
+        TcpConnectionPtr peer = relayPeer_.lock();
+        if(peer && peer->state_ == kConnected && peer->reading_ && !peer->channel_.isReading()) {
+            peer->channel_.enableReading();
+        }
+    }
+
+    if(channel_.isWriting()) {
+        channel_.disableWriting();
+    }
+    cancelWriteDeadline();
+    if(callbacks_->writeCompleteCallback) {
+        // 唤醒 loop_ 对应的 thread 线程执行回调
+        loop_->queueInLoop(std::bind(callbacks_->writeCompleteCallback, shared_from_this()));
+    }
+    if(state_ == kDisconnecting) {
+        shutdownInLoop();
+    }
+}
+
+void TcpConnection::recordRead(ssize_t n, int savedErrno) {
+    traffic_.onRead(n);
+    if(trafficAggregate_) {
+        trafficAggregate_->onRead(n);
+    }
+    if(n < 0 && (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)) {
+        traffic_.onEagain();
+        if(trafficAggregate_) {
+            trafficAggregate_->onEagain();
         }
-        outputBuffer_.append((char *)data + nwrote, remaining);
-        if(!channel_->isWriting()) {
-            // 注册 channel 的写事件
-            channel_->enableWriting();
-        } 
+    }
+}
+
+void TcpConnection::recordWrite(ssize_t n, int savedErrno) {
+    traffic_.onWrite(n);
+    if(trafficAggregate_) {
+        trafficAggregate_->onWrite(n);
+    }
+    if(n < 0 && (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)) {
+        traffic_.onEagain();
+        if(trafficAggregate_) {
+            trafficAggregate_->onEagain();
+        }
+    }
+}
+
+void TcpConnection::recordReadBudgetHit() {
+    traffic_.onReadBudgetHit();
+    if(trafficAggregate_) {
+        trafficAggregate_->onReadBudgetHit();
+    }
+}
+
+void TcpConnection::recordMessageIn() {
+    traffic_.onMessageIn();
+    if(trafficAggregate_) {
+        trafficAggregate_->onMessageIn();
+    }
+}
+
+void TcpConnection::recordMessageOut() {
+    traffic_.onMessageOut();
+    if(trafficAggregate_) {
+        trafficAggregate_->onMessageOut();
+    }
+}
+
+void TcpConnection::recordConnected() {
+    connectedAt_ = Timestamp::now();
+    traffic_.onConnected(connectedAt_);
+    if(trafficAggregate_) {
+        trafficAggregate_->onConnected(connectedAt_);
+    }
+    trafficConnected_ = true;
+}
+
+void TcpConnection::recordDisconnected() {
+    if(!trafficConnected_) {
+        return ;
+    }
+    Timestamp now(Timestamp::now());
+    traffic_.onDisconnected(connectedAt_, now);
+    if(trafficAggregate_) {
+        trafficAggregate_->onDisconnected(connectedAt_, now);
+    }
+    trafficConnected_ = false;
+}
+
+void TcpConnection::outputAppended() {
+    const size_t buffered = bufferedOutputBytes();
+    traffic_.onOutputBuffered(buffered);
+    if(trafficAggregate_) {
+        trafficAggregate_->onOutputBuffered(buffered);
+    }
+    if(callbacks_->lowWaterMarkCallback && buffered >= lowWaterMark_) {
+        aboveLowWaterMark_ = true;
+    }
+    if(maxOutputBytes_ > 0 && buffered > maxOutputBytes_) {
+        evictSlowConsumer("output buffer limit exceeded");
+    }
+    if(backpressureHigh_ > 0 && !backpressurePaused_ && buffered >= backpressureHigh_) {
+        TcpConnectionPtr source = backpressureSource_.lock();
+        if(source) {
+            LOG_INFO << "TcpConnection::outputAppended [" << name() << "] " << buffered
+                     << " bytes pending, stop reading [" << source->name() << "]";
+            source->stopRead();
+            backpressurePaused_ = true;
+        }
+    }
+}
+
+void TcpConnection::outputRetrieved() {
+    const size_t buffered = bufferedOutputBytes();
+    if(aboveLowWaterMark_ && buffered < lowWaterMark_) {
+        aboveLowWaterMark_ = false;
+        if(callbacks_->lowWaterMarkCallback) {
+            loop_->queueInLoop(std::bind(callbacks_->lowWaterMarkCallback, shared_from_this(), buffered));
+        }
+    }
+    if(backpressurePaused_ && buffered < backpressureLow_) {
+        backpressurePaused_ = false;
+        TcpConnectionPtr source = backpressureSource_.lock();
+        if(source) {
+            source->startRead();
+        }
+    }
+}
+
+void TcpConnection::setBackpressure(const TcpConnectionPtr &source, size_t highWaterMark, size_t lowWaterMark) {
+    loop_->assertInLoopThread();
+    // 替换或取消之前的 source 时，先恢复被它暂停的读取
+    if(backpressurePaused_) {
+        TcpConnectionPtr old = backpressureSource_.lock();
+        if(old) {
+            old->startRead();
+        }
+        backpressurePaused_ = false;
+    }
+
+    backpressureSource_ = source;
+    backpressureHigh_ = source ? highWaterMark : 0;
+    backpressureLow_ = std::min(lowWaterMark, highWaterMark);
+    if(source) {
+        outputAppended();
+    }
+}
+
+void TcpConnection::setWriteDeadline(double timeoutSeconds, size_t maxOutputBytes) {
+    writeTimeout_ = timeoutSeconds;
+    maxOutputBytes_ = maxOutputBytes;
+}
+
+void TcpConnection::startWriting() {
+    if(channel_.isWriting()) {
+        return ;
+    }
+    channel_.enableWriting();
+
+    if(writeTimeout_ > 0.0 && !writeTimerArmed_) {
+        // 定时器只持有 weak_ptr，不延长连接的生命期
+        std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+        writeTimer_ = loop_->runAfter(writeTimeout_, [weakConn]() {
+            TcpConnectionPtr conn = weakConn.lock();
+            if(conn) {
+                conn->handleWriteTimeout();
+            }
+        });
+        writeTimerArmed_ = true;
+    }
+}
+
+void TcpConnection::cancelWriteDeadline() {
+    if(writeTimerArmed_) {
+        loop_->cancel(writeTimer_);
+        writeTimerArmed_ = false;
+    }
+}
+
+void TcpConnection::handleWriteTimeout() {
+    writeTimerArmed_ = false;
+    if(channel_.isWriting()) {
+        evictSlowConsumer("write deadline exceeded");
+    }
+}
+
+void TcpConnection::evictSlowConsumer(const char *reason) {
+    if(evicted_ || state_ == kDisconnected) {
+        return ;
+    }
+    evicted_ = true;
+    LOG_ERROR << "TcpConnection::evictSlowConsumer [" << name() << "] " << reason
+              << ", " << bufferedOutputBytes() << " bytes pending";
+
+    if(callbacks_->slowConsumerCallback) {
+        callbacks_->slowConsumerCallback(shared_from_this());
+    }
+    forceClose();
+}
+
+void TcpConnection::startRead() {
+    loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::startReadInLoop() {
+    loop_->assertInLoopThread();
+    if(state_ == kDisconnected) {
+        return ;
+    }
+    if(!reading_ || !channel_.isReading()) {
+        channel_.enableReading();
+        reading_ = true;
+    }
+}
+
+void TcpConnection::stopRead() {
+    loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::stopReadInLoop() {
+    loop_->assertInLoopThread();
+    if(state_ == kDisconnected) {
+        return ;
+    }
+    if(reading_ || channel_.isReading()) {
+        channel_.disableReading();
+        reading_ = false;
     }
 }
 
@@ -126,9 +946,14 @@ void TcpConnection::shutdown() {
     }
 }
 
+/**
+ * 所有待发送的数据（outputBuffer_、文件、转发的 pipe，以及写合并等待本轮结束时发送的数据）都发送完以后才关闭写端
+ * 否则由 flushCoalesced / handleOutputDrained 在数据发送完以后再调用
+*/
 void TcpConnection::shutdownInLoop() {
-    if(!channel_->isWriting()) {    // 说明当前 outputBuffer 中的数据已经全部发送完成
-        socket_->shutdownWrite();   // 关闭写端，会触发 EPOLLHUP 事件
+    if(!channel_.isWriting() && !flushScheduled_ && outputBuffer_.readableBytes() == 0
+        && pendingFiles_.empty() && relayPipeBytes_ == 0) {
+        socket_.shutdownWrite();   // 关闭写端，会触发 EPOLLHUP 事件
     }
 }
 
@@ -136,32 +961,53 @@ void TcpConnection::shutdownInLoop() {
 // 连接建立
 void TcpConnection::connectEstablished() {
     setState(kConnected);
-    channel_->tie(shared_from_this());
-    channel_->enableReading();  // 向 Poller 注册 channel 的 EPOLLIN 事件
+    recordConnected();
+    // 代替 channel_.tie：channel_ 注册期间由 self_ 保证 TcpConnection 不会析构
+    self_ = shared_from_this();
+    if(reading_) {
+        channel_.enableReading();  // 向 Poller 注册 channel 的 EPOLLIN 事件
+    }
 
     // 新连接建立，执行回调（这个回调是用户自定义的）
-    connectionCallback_(shared_from_this());
+    callbacks_->connectionCallback(self_);
 }
 
 // 连接销毁
 void TcpConnection::connectDestroyed() {
     if(state_ == kConnected) {
         setState(kDisconnected);
-        channel_->disableAll();     // 把 channel 所有感兴趣的事件从 Poller 中删除
-        connectionCallback_(shared_from_this());
+        channel_.disableAll();     // 把 channel 所有感兴趣的事件从 Poller 中删除
+        recordDisconnected();
+        callbacks_->connectionCallback(shared_from_this());
     }
 
     // 把 channel 从 Poller 中删除掉
-    channel_->remove();
+    channel_.remove();
+    cancelWriteDeadline();
+    // channel_ 不会再被回调，释放对自己的引用（调用方还持有一份，这里不会析构）
+    TcpConnectionPtr self;
+    self.swap(self_);
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime) {
+    if(relaying_) {
+        handleRelayRead(relayPeer_.lock());
+        return ;
+    }
+
+    // 读满预算以后不再继续读，剩下的数据让 epoll 在下一轮再报告，先处理同一个 loop 上的其他连接
+    const size_t budget = loop_->readBudget();
     int savedErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    ssize_t n = inputBuffer_.readFd(channel_.fd(), &savedErrno, budget > 0 ? budget : SIZE_MAX);
+    recordRead(n, savedErrno);
+    if(budget > 0 && n == static_cast<ssize_t>(budget)) {
+        recordReadBudgetHit();
+    }
 
     if(n > 0) {
         // 以建立连接的用户，有可读事件发生，调用用户传入的回调操作 onMessage()
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        recordMessageIn();
+        callbacks_->messageCallback(self_, &inputBuffer_, receiveTime);
     } else if(n == 0) {
         handleClose();
     } else {
@@ -172,53 +1018,77 @@ void TcpConnection::handleRead(Timestamp receiveTime) {
 }
 
 void TcpConnection::handleWrite() {
-    if(channel_->isWriting()) {
-        int savedErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
-        if(n > 0) {
-            outputBuffer_.retrieve(n);
-            if(outputBuffer_.readableBytes() == 0) {
-                channel_->disableWriting();
-                if(writeCompleteCallback_) {
-                    // 唤醒 loop_ 对应的 thread 线程执行回调
-                    loop_->queueInLoop(
-                        std::bind(writeCompleteCallback_, shared_from_this()));
-                }
-                if(state_ == kDisconnecting) {
-                    shutdownInLoop();
-                }
+    if(channel_.isWriting()) {
+        if(outputBuffer_.readableBytes() > 0) {
+            int savedErrno = 0;
+            ssize_t n = outputBuffer_.writeFd(channel_.fd(), &savedErrno);
+            recordWrite(n, savedErrno);
+            if(n > 0) {
+                outputBuffer_.retrieve(n);
+                outputRetrieved();
+            } else {
+                LOG_ERROR << "TcpConnection::handleWrite error";
+                return ;
             }
-        } else {
-            LOG_ERROR << "TcpConnection::handleWrite error";
+        }
+        // outputBuffer_ 发送完以后再接着发送排在后面的文件，最后是转发过来的数据
+        if(drainPendingFiles() && flushRelayPipe()) {
+            handleOutputDrained();
         }
     } else {
-        LOG_ERROR << "TcpConnection fd = " << channel_->fd() << " is down, now more writing";
+        LOG_ERROR << "TcpConnection fd = " << channel_.fd() << " is down, now more writing";
     }
 }
 
 // Poller 通知 Channel 调用 closeCallback_ 回调，该回调就是 handleClose 方法
-// 在 handleClose 方法中分别调用了 用户注册的回调(connectionCallback_) 和 TcpServer 注册的关闭回调(closeCallback_)
+// 在 handleClose 方法中分别调用了 用户注册的回调(connectionCallback) 和 TcpServer 注册的关闭回调(closeCallback)
 // 执行 TcpServer 注册的回调也就是 TcpServer::removeConnection 方法
 void TcpConnection::handleClose() {
-    LOG_INFO << "TcpConnection::handleClose fd = " << channel_->fd() << ", state = " << state_;
+    LOG_INFO << "TcpConnection::handleClose fd = " << channel_.fd() << ", state = " << state_;
     setState(kDisconnected);
-    channel_->disableAll();     // 删除所有感兴趣的事件
+    channel_.disableAll();     // 删除所有感兴趣的事件
+    cancelWriteDeadline();
+    recordDisconnected();
+
+    /**
+     * 转发模式下对端不会再收到新数据，等 peer 发送完积压的数据后关闭它的写端
+     * 转发给当前连接的数据已经发不出去了，关闭 pipe；peer 可能因为当前连接积压而暂停了读取，
+     * 这里恢复读取，之后读到的数据直接丢弃（见 handleRelayRead），这样 peer 才能发现它自己的关闭
+    */
+    if(relaying_) {
+        closeRelayPipe();
+        relayPipeBytes_ = 0;
+        TcpConnectionPtr peer = relayPeer_.lock();
+        if(peer) {
+            if(peer->state_ != kDisconnected && peer->reading_ && !peer->channel_.isReading()) {
+                peer->channel_.enableReading();
+            }
+            peer->shutdown();
+        }
+    }
 
     TcpConnectionPtr connPtr(shared_from_this());
-    connectionCallback_(connPtr);   // 执行用户注册的连接关闭的回调
-    closeCallback_(connPtr);        // 关闭连接的回调（该回调是 TcpServer 注册的）
+    // 用户回调中可能会修改回调，先持有当前的回调表
+    TcpConnectionCallbacksPtr callbacks(callbacks_);
+    callbacks->connectionCallback(connPtr);     // 执行用户注册的连接关闭的回调
+    callbacks->closeCallback(connPtr);          // 关闭连接的回调（该回调是 TcpServer 注册的）
 }
 
 void TcpConnection::handleError() {
+    // zerocopy 的完成通知通过错误队列上报，会触发 EPOLLERR，这种情况不是真正的错误
+    if(zeroCopy_ && handleZeroCopyCompletions()) {
+        return ;
+    }
+
     int optval;
     socklen_t optlen = sizeof(optval);
     int err = 0;
-    if(::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0) {
+    if(::getsockopt(channel_.fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0) {
         err = errno;
     } else {
         err = optval;
     }
-    LOG_ERROR << "TcpConnection::handleError name: " << name_ << " - SO_ERROR: " << err;
+    LOG_ERROR << "TcpConnection::handleError name: " << name() << " - SO_ERROR: " << err;
 }
 
 void TcpConnection::forceClose() {
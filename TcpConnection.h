@@ -3,19 +3,28 @@
 
 #include <memory>
 #include <string>
+#include <vector>
+#include <deque>
 #include <atomic>
+#include <mutex>
+#include <sys/types.h>
 
 #include "noncopyable.h"
 #include "InetAddress.h"
 #include "Callbacks.h"
 #include "Buffer.h"
 #include "Timestamp.h"
+#include "StringPiece.h"
+#include "TimerId.h"
+#include "SocketOptions.h"
+#include "TcpInfo.h"
+#include "TrafficCounters.h"
+#include "Socket.h"
+#include "Channel.h"
 
 namespace mymuduo {
 
-class Channel;
 class EventLoop;
-class Socket;
 
 /**
  * 当有一个新用户连接时，机会通过 accept 拿到 connfd，之后把 connfd 包装成 TcpConnection 对象，
@@ -24,46 +33,188 @@ class Socket;
 */
 class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection> {
 public:
+    static const size_t kDefaultZeroCopyThreshold = 64 * 1024;
+    static const size_t kDefaultCoalesceThreshold = 64 * 1024;
+
     TcpConnection(EventLoop *loop,
                     const std::string &nameArg,
                     int sockfd,
                     const InetAddress &localAddr,
                     const InetAddress &peerAddr);
+    /**
+     * TcpServer 使用的构造函数：连接只用 64 位的 id 标识，
+     * 名字（namePrefix#id）只在第一次调用 name() 时生成，不打印日志时不会为每个连接拼接字符串
+    */
+    TcpConnection(EventLoop *loop,
+                    uint64_t id,
+                    const std::shared_ptr<const std::string> &namePrefix,
+                    int sockfd,
+                    const InetAddress &localAddr,
+                    const InetAddress &peerAddr);
     ~TcpConnection();
 
     EventLoop *getLoop() const { return loop_; }
-    const std::string &name() const { return name_; }
+    uint64_t id() const { return id_; }
+    const std::string &name() const;
     const InetAddress &localAddress() const { return localAddr_; }
     const InetAddress &peerAddress() const { return peerAddr_; }
 
     bool connected() const { return state_ == kConnected; }
+    bool disconnected() const { return state_ == kDisconnected; }
+
+    // 设置连接 socket 的选项，一般由 TcpServer / TcpClient 在连接建立时调用
+    void setSocketOptions(const SocketOptions &options);
+    // 内核 TCP_INFO 的快照（RTT、拥塞窗口、重传等），可以在任意线程中调用
+    bool getTcpInfo(TcpInfo *info) const;
+
+    /**
+     * 连接的 channel 在 loop 中的优先级（EventPriority），如管理 / 健康检查连接用 kHighPriority，批量传输用 kLowPriority
+     * 需要在 loop 线程中调用（例如 connectionCallback 中），或者连接建立之前
+    */
+    void setPriority(EventPriority priority) { channel_.setPriority(priority); }
+    EventPriority priority() const { return channel_.priority(); }
 
-    // 发送数据
+    // 当前连接的流量统计，可以在任意线程中调用
+    TrafficStats trafficStats() const { return traffic_.snapshot(); }
+    // 同时把流量计入 aggregate（如 TcpServer 在每个 loop 上的汇总），需要在连接建立之前设置
+    void setTrafficAggregate(const std::shared_ptr<TrafficCounters> &aggregate) {
+        trafficAggregate_ = aggregate;
+    }
+
+    /**
+     * 发送数据，可以在任意线程中调用
+     * 在其它线程中调用时，数据的所有权交给投递到 loop 线程的任务，不会和其它线程的 send 共享任何中间状态
+    */
     void send(const std::string &buf);
+    // 跨线程时直接把 buf 移动到任务中，不拷贝数据
+    void send(std::string &&buf);
+    // 发送 buf 中的全部可读数据并清空 buf；跨线程时把 buf 的内存移动到任务中，不拷贝数据
+    void send(Buffer *buf);
+    // 在 loop 线程中调用时不会拷贝 data，内核没有接收的部分才会拷贝到 outputBuffer_
+    void send(const void *data, size_t len);
+    // 聚合发送多个数据片段（如 header + body），和 outputBuffer_ 中的待发送数据一起通过一次 writev 发出
+    void send(const std::vector<StringPiece> &slices);
+    /**
+     * 零拷贝发送文件 fd 中 [offset, offset + length) 区域的数据（sendfile）
+     * 文件区域排在此前所有待发送数据之后，之后 send 的数据也会排在它后面
+     * 内部会 dup 一份 fd，调用方可以在 sendFile 返回后立即关闭自己的 fd
+    */
+    void sendFile(int fd, off_t offset, size_t length);
+    /**
+     * 发送共享所有权的数据，不会拷贝 payload
+     * 开启 zerocopy 后，长度不小于阈值的 payload 通过 MSG_ZEROCOPY 发送，并一直持有到内核通知发送完成
+    */
+    void send(const std::shared_ptr<const std::string> &payload);
+
+    /**
+     * 写合并（应用层 cork）：开启后同一轮事件循环中多次 send 的数据先累积在 outputBuffer_ 中，
+     * 在本轮处理完所有活跃的 channel 和回调以后统一用一次 writev 发出；累积超过 threshold 时立即发送
+     * 需要在 loop 线程中调用
+    */
+    void setWriteCoalescing(bool on, size_t threshold = kDefaultCoalesceThreshold);
+
+    // 开启 MSG_ZEROCOPY 发送，需要在 loop 线程中调用（如 connectionCallback），返回 false 表示内核不支持
+    bool enableZeroCopy(size_t threshold = kDefaultZeroCopyThreshold);
+    // 已经交给内核但还没有收到完成通知的 zerocopy 发送次数
+    size_t zeroCopyPending() const { return zeroCopyPayloads_.size(); }
+    /**
+     * 把当前连接和 peer 互相转发（四层代理），两个连接必须属于同一个 loop，需要在 loop 线程中调用
+     * 数据通过 pipe + splice 在两个 socket 之间搬运，不经过用户态；一方发不出去时暂停读取另一方
+     * 内核不支持 splice 时退回到经过 inputBuffer_ / outputBuffer_ 的拷贝转发
+     * 开启转发后不会再调用 messageCallback，也不要再通过 send 向这两个连接写数据
+     * 一方关闭或者出错（如收到 RST）以后，另一方发送完已经收到的数据后关闭写端，之后读到的数据直接丢弃
+    */
+    void startRelay(const TcpConnectionPtr &peer);
+    /**
+     * 暂停 / 恢复读取当前连接，可以在任意线程中调用
+     * 暂停期间内核接收缓冲区填满后对端的发送窗口会收缩到 0，从而把压力传递给发送方
+    */
+    void startRead();
+    void stopRead();
+    bool isReading() const { return reading_; }
+
+    /**
+     * 读端背压：当前连接用户态的积压（包括排在 sendFile 后面的数据）达到 highWaterMark 时暂停读取 source，
+     * 积压降到 lowWaterMark 以下时恢复读取；source 可以是转发数据过来的另一个连接，也可以是当前连接自己
+     * source 只以 weak_ptr 保存，需要在 loop 线程中调用，传入空指针表示取消
+    */
+    void setBackpressure(const TcpConnectionPtr &source, size_t highWaterMark, size_t lowWaterMark);
+
+    /**
+     * 慢消费者驱逐：待发送数据超过 timeoutSeconds 秒仍没有发送完，或者积压（包括排在 sendFile 后面的数据）超过 maxOutputBytes，
+     * 就调用 slowConsumerCallback 并强制关闭连接；参数为 0 表示不检查该项，需要在 loop 线程中调用
+    */
+    void setWriteDeadline(double timeoutSeconds, size_t maxOutputBytes);
+
+    /**
+     * 连接上下文：保存任意类型的会话状态，一般在 connectionCallback 中设置，在 messageCallback 中直接取出，
+     * 不需要再用额外的 map 按连接查找；只应该在 loop 线程中访问
+     * getContext<T>() 的类型和设置时不一致（或没有设置）时返回 nullptr，比较类型只需要一次指针比较
+    */
+    template<typename T>
+    void setContext(const std::shared_ptr<T> &context) {
+        context_ = context;
+        contextType_ = contextTypeId<T>();
+    }
+    // 原地构造一个 T 作为上下文，返回指向它的指针
+    template<typename T, typename... Args>
+    T *emplaceContext(Args&&... args) {
+        std::shared_ptr<T> context = std::make_shared<T>(std::forward<Args>(args)...);
+        setContext(context);
+        return context.get();
+    }
+    template<typename T>
+    T *getContext() const {
+        return contextType_ == contextTypeId<T>() ? static_cast<T *>(context_.get()) : nullptr;
+    }
+    void clearContext() {
+        context_.reset();
+        contextType_ = nullptr;
+    }
+
     // 关闭连接
     void shutdown();
 
     void forceClose();
 
+    /**
+     * 使用一张共享的回调表（一般由 TcpServer / TcpClient 在连接建立之前设置），表本身不会被修改
+     * 之后再调用下面的 setXXXCallback 只会修改当前连接自己的副本，不影响共享这张表的其它连接
+    */
+    void setCallbacks(const TcpConnectionCallbacksPtr &callbacks) {
+        callbacks_ = callbacks;
+        ownedCallbacks_ = nullptr;
+    }
+
     void setConnectionCallback(const ConnectionCallback &cb) {
-        connectionCallback_ = cb;
+        mutableCallbacks()->connectionCallback = cb;
     }
 
     void setMessageCallback(const MessageCallback &cb) {
-        messageCallback_ = cb;
+        mutableCallbacks()->messageCallback = cb;
     }
 
     void setWriteCompleteCallback(const WriteCompleteCallback &cb) {
-        writeCompleteCallback_ = cb;
+        mutableCallbacks()->writeCompleteCallback = cb;
     }
 
     void setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark) {
-        highWaterMarkCallback_ = cb;
+        mutableCallbacks()->highWaterMarkCallback = cb;
         highWaterMark_ = highWaterMark;
     }
 
+    // outputBuffer_ 中的积压从不低于 lowWaterMark 降到 lowWaterMark 以下时回调
+    void setLowWaterMarkCallback(const LowWaterMarkCallback &cb, size_t lowWaterMark) {
+        mutableCallbacks()->lowWaterMarkCallback = cb;
+        lowWaterMark_ = lowWaterMark;
+    }
+
+    void setSlowConsumerCallback(const SlowConsumerCallback &cb) {
+        mutableCallbacks()->slowConsumerCallback = cb;
+    }
+
     void setCloseCallback(const CloseCallback &cb) {
-        closeCallback_ = cb;
+        mutableCallbacks()->closeCallback = cb;
     }
 
     // 连接建立
@@ -79,43 +230,181 @@ private:
         kDisconnecting
     };
     
+    TcpConnection(EventLoop *loop,
+                    uint64_t id,
+                    const std::shared_ptr<const std::string> &namePrefix,
+                    const std::string &nameArg,
+                    int sockfd,
+                    const InetAddress &localAddr,
+                    const InetAddress &peerAddr);
+
     void setState(StateE state) { state_ = state; }
 
+    // 第一次单独修改回调时复制一份共享的回调表，之后直接修改这份副本
+    TcpConnectionCallbacks *mutableCallbacks();
+
+    // 每个类型一个唯一的地址，用来代替 typeid
+    template<typename T>
+    static const void *contextTypeId() {
+        static const char id = 0;
+        return &id;
+    }
+
     void handleRead(Timestamp receiveTime);
+    // peer 为空表示转发的对方已经析构
+    void handleRelayRead(const TcpConnectionPtr &peer);
     void handleWrite();
     void handleClose();
     void handleError();
 
     void sendInLoop(const void *data, size_t len);
+    void sendSlicesInLoop(const StringPiece *slices, size_t count);
+    // 把 outputBuffer_ 中的数据和 slices 一起 writev 出去
+    void writeSlicesInLoop(const StringPiece *slices, size_t count, size_t len);
+    // 每轮事件循环结束时发送写合并累积的数据
+    void flushCoalesced();
+    void sendStringInLoop(const std::string &message);
+    void sendBufferInLoop(const Buffer &buf);
+    void sendFileInLoop(int fd, off_t offset, size_t length);
+    void sendPayloadInLoop(const std::shared_ptr<const std::string> &payload);
+    // 从 socket 的错误队列中读取 zerocopy 完成通知，释放对应的 payload，返回 true 表示读到了完成通知
+    bool handleZeroCopyCompletions();
+    // 发送 pendingFiles_ 队首的文件区域，返回 true 表示该区域已经处理完毕
+    bool sendFileRegion();
+    // outputBuffer_ 为空时依次发送排队的文件区域，返回 true 表示所有待发送数据都已发送完
+    bool drainPendingFiles();
+    // 发送出错，丢弃所有待发送的数据并关闭连接
+    void abortOutput();
+    // 所有待发送数据都发送完以后的处理
+    void handleOutputDrained();
+
+    void startReadInLoop();
+    void stopReadInLoop();
+    // 更新流量统计，n 和 savedErrno 是系统调用的返回值和 errno
+    void recordRead(ssize_t n, int savedErrno);
+    void recordWrite(ssize_t n, int savedErrno);
+    void recordReadBudgetHit();
+    void recordMessageIn();
+    void recordMessageOut();
+    void recordConnected();
+    void recordDisconnected();
+
+    // 积压在用户态的待发送数据，包括排在文件后面的数据
+    size_t bufferedOutputBytes() const {
+        return outputBuffer_.readableBytes() + followingBytes_;
+    }
+    // 待发送的数据增加 / 减少以后检查低水位回调、背压和慢消费者上限
+    void outputAppended();
+    void outputRetrieved();
+
+    // 注册写事件，有数据积压在内核之外时开始计算写超时
+    void startWriting();
+    void cancelWriteDeadline();
+    void handleWriteTimeout();
+    void evictSlowConsumer(const char *reason);
+
+    void setupRelay(const TcpConnectionPtr &peer);
+    void closeRelayPipe();
+    // 把 relayPipe_ 中的数据 splice 到 socket，返回 true 表示 pipe 已经清空
+    bool flushRelayPipe();
+    // 转发出错，关闭 pipe 和当前连接
+    void abortRelay();
+    // 当前连接的待发送数据是否有积压（转发时用于暂停读取 peer）
+    bool hasPendingOutput() const {
+        return outputBuffer_.readableBytes() > 0 || !pendingFiles_.empty() || relayPipeBytes_ > 0;
+    }
 
     void shutdownInLoop();
 
     void forceCloseInLoop();
 
     EventLoop *loop_;   // 这里是某个 subLoop
-    const std::string name_;
+    const uint64_t id_;
+    const std::shared_ptr<const std::string> namePrefix_;
+    mutable std::string name_;          // 由 name() 按需生成
+    mutable std::once_flag nameOnce_;
     std::atomic_int state_;
     bool reading_;
 
     // 这里和 Acceptor 类似，Accept 在 mainLoop 中，TcpConnection 在 subLoop 中
-    std::unique_ptr<Socket> socket_;
-    std::unique_ptr<Channel> channel_;
+    // 直接作为成员，和 TcpConnection 在同一块内存中，建立连接时不需要单独分配
+    Socket socket_;
+    Channel channel_;
+    /**
+     * channel_ 注册在 Poller 上期间（connectEstablished 到 connectDestroyed）持有自己，
+     * 事件回调直接把 self_ 的引用交给用户，不需要每次都 shared_from_this / tie_.lock()，分发事件时没有原子操作
+    */
+    TcpConnectionPtr self_;
 
     const InetAddress localAddr_;
     const InetAddress peerAddr_;
 
-    ConnectionCallback connectionCallback_;             // 有新连接时的回调
-    MessageCallback messageCallback_;                   // 有读写消息时的回调
-    WriteCompleteCallback writeCompleteCallback_;       // 消息发送完成以后的回调
-    HighWaterMarkCallback highWaterMarkCallback_;
-    CloseCallback closeCallback_;
+    // 连接建立、读写消息、发送完成、关闭等回调，一般和同一个 loop 上的其它连接共享
+    TcpConnectionCallbacksPtr callbacks_;
+    TcpConnectionCallbacks *ownedCallbacks_;    // 不为空时 callbacks_ 是当前连接独占的副本
     size_t highWaterMark_;
+    size_t lowWaterMark_;
+    bool aboveLowWaterMark_;        // 积压是否达到过 lowWaterMark_，降下来时才回调
+
+    // 背压：积压超过 backpressureHigh_ 时暂停读取 backpressureSource_，降到 backpressureLow_ 以下时恢复
+    std::weak_ptr<TcpConnection> backpressureSource_;
+    size_t backpressureHigh_;
+    size_t backpressureLow_;
+    bool backpressurePaused_;
+
+    // 慢消费者驱逐
+    double writeTimeout_;
+    size_t maxOutputBytes_;
+    TimerId writeTimer_;
+    bool writeTimerArmed_;
+    bool evicted_;
+    bool outputAborted_;        // 调用过 abortOutput，之后的数据都不再发送
+
+    std::shared_ptr<void> context_;
+    const void *contextType_;
 
     Buffer inputBuffer_;        // 接收数据的缓冲区
     Buffer outputBuffer_;       // 发送数据的缓冲区
 
-    std::string sendMsg;
-    size_t sendMsgLen;
+    // 等待 sendfile 发送的文件区域，following 保存排在该文件后面 send 的数据
+    struct FileRegion {
+        FileRegion(int fdArg, off_t offsetArg, size_t lengthArg)
+            : fd(fdArg), offset(offsetArg), remaining(lengthArg) {}
+
+        int fd;
+        off_t offset;
+        size_t remaining;
+        Buffer following;
+    };
+    std::deque<FileRegion> pendingFiles_;
+    size_t followingBytes_;     // 所有 FileRegion::following 中的字节数之和
+
+    // 以 MSG_ZEROCOPY 发送的 payload，seq 是内核为每次成功的 zerocopy 发送分配的序号
+    struct ZeroCopyPayload {
+        uint32_t seq;
+        std::shared_ptr<const std::string> payload;
+    };
+    bool coalescing_;
+    size_t coalesceThreshold_;
+    bool flushScheduled_;       // 本轮事件循环是否已经登记了 flushCoalesced
+
+    // 转发模式：从当前连接读到的数据转发给 relayPeer_
+    // relayPipe_ 中保存的是 peer 读到、还没有写到当前 socket 的数据
+    std::weak_ptr<TcpConnection> relayPeer_;
+    bool relaying_;
+    int relayPipe_[2];
+    size_t relayPipeBytes_;
+
+    // 流量统计，只在 loop 线程中更新
+    TrafficCounters traffic_;
+    std::shared_ptr<TrafficCounters> trafficAggregate_;
+    bool trafficConnected_;     // 是否已经计入了连接数
+    Timestamp connectedAt_;
+
+    bool zeroCopy_;
+    size_t zeroCopyThreshold_;
+    uint32_t zeroCopySeq_;
+    std::deque<ZeroCopyPayload> zeroCopyPayloads_;
 };
 
 }   // namespace mymuduo
@@ -0,0 +1,35 @@
+#include "TcpInfo.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>      // glibc 的 struct tcp_info 没有 tcpi_delivery_rate 等新字段
+#include <stddef.h>
+#include <string.h>
+
+namespace mymuduo {
+
+bool TcpInfo::get(int sockfd, TcpInfo *info) {
+    struct tcp_info ti;
+    ::memset(&ti, 0, sizeof(ti));
+    socklen_t len = sizeof(ti);
+    if(::getsockopt(sockfd, IPPROTO_TCP, TCP_INFO, &ti, &len) < 0) {
+        return false;
+    }
+
+    info->rttUs = ti.tcpi_rtt;
+    info->rttVarUs = ti.tcpi_rttvar;
+    info->sndCwnd = ti.tcpi_snd_cwnd;
+    info->sndMss = ti.tcpi_snd_mss;
+    info->unacked = ti.tcpi_unacked;
+    info->retransmits = ti.tcpi_retransmits;
+    info->totalRetrans = ti.tcpi_total_retrans;
+    // 旧内核返回的结构体较短，没有包含 delivery_rate
+    if(len >= offsetof(struct tcp_info, tcpi_delivery_rate) + sizeof(ti.tcpi_delivery_rate)) {
+        info->deliveryRate = ti.tcpi_delivery_rate;
+    } else {
+        info->deliveryRate = 0;
+    }
+    return true;
+}
+
+}   // namespace mymuduo
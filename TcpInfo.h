@@ -0,0 +1,25 @@
+#ifndef _TCPINFO_H
+#define _TCPINFO_H
+
+#include <stdint.h>
+
+namespace mymuduo {
+
+// 内核 TCP_INFO 中常用字段的快照
+struct TcpInfo {
+    uint32_t rttUs;             // 平滑后的 RTT，微秒
+    uint32_t rttVarUs;          // RTT 的平均偏差，微秒
+    uint32_t sndCwnd;           // 拥塞窗口，单位为报文段
+    uint32_t sndMss;
+    uint32_t unacked;           // 已发送但还没有被确认的报文段数
+    uint32_t retransmits;       // 当前这次超时重传的次数
+    uint32_t totalRetrans;      // 连接建立以来重传的报文段总数
+    uint64_t deliveryRate;      // 最近一次测量的发送速率，字节/秒，内核不支持时为 0
+
+    // 读取 sockfd 的 TCP_INFO，失败返回 false
+    static bool get(int sockfd, TcpInfo *info);
+};
+
+}   // namespace mymuduo
+
+#endif
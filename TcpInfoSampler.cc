@@ -0,0 +1,105 @@
+#include "TcpInfoSampler.h"
+#include "TcpConnection.h"
+#include "TcpInfo.h"
+#include "EventLoop.h"
+
+#include <functional>
+
+namespace mymuduo {
+
+void TcpInfoStats::merge(const TcpInfoStats &other) {
+    samples += other.samples;
+    retransmits += other.retransmits;
+    rttUs.merge(other.rttUs);
+    rttVarUs.merge(other.rttVarUs);
+    sndCwnd.merge(other.sndCwnd);
+    unacked.merge(other.unacked);
+    deliveryRate.merge(other.deliveryRate);
+}
+
+TcpInfoSampler::TcpInfoSampler(EventLoop *loop, double interval)
+    : loop_(loop),
+      interval_(interval),
+      started_(false) {}
+
+TcpInfoSampler::~TcpInfoSampler() {
+    if(started_) {
+        loop_->cancel(timer_);
+    }
+}
+
+void TcpInfoSampler::start() {
+    // 定时器只持有 weak_ptr，sampler 析构以后即使定时器还没有被取消也不会访问它
+    std::weak_ptr<TcpInfoSampler> weakSampler(shared_from_this());
+    timer_ = loop_->runEvery(interval_, [weakSampler]() {
+        std::shared_ptr<TcpInfoSampler> sampler = weakSampler.lock();
+        if(sampler) {
+            sampler->sample();
+        }
+    });
+    started_ = true;
+}
+
+void TcpInfoSampler::add(const TcpConnectionPtr &conn) {
+    loop_->runInLoop(std::bind(&TcpInfoSampler::addInLoop, shared_from_this(), conn));
+}
+
+void TcpInfoSampler::addInLoop(const TcpConnectionPtr &conn) {
+    // 登记之前连接已经关闭（remove 已经执行过），不再登记
+    if(conn->disconnected()) {
+        return ;
+    }
+    Entry entry;
+    entry.conn = conn;
+    entry.lastTotalRetrans = 0;
+    TcpInfo info;
+    if(conn->getTcpInfo(&info)) {
+        entry.lastTotalRetrans = info.totalRetrans;
+    }
+    entries_[conn.get()] = entry;
+}
+
+void TcpInfoSampler::remove(const TcpConnectionPtr &conn) {
+    loop_->assertInLoopThread();
+    entries_.erase(conn.get());
+}
+
+void TcpInfoSampler::sample() {
+    loop_->assertInLoopThread();
+
+    // 先在局部统计，最后加锁合并一次
+    TcpInfoStats stats;
+    for(auto it = entries_.begin(); it != entries_.end(); ) {
+        Entry &entry = it->second;
+        TcpConnectionPtr conn = entry.conn.lock();
+        if(!conn) {
+            it = entries_.erase(it);     // 没有经过 remove 就销毁的连接，在这里移除
+            continue;
+        }
+
+        TcpInfo info;
+        if(conn->connected() && conn->getTcpInfo(&info)) {
+            stats.samples++;
+            stats.retransmits += info.totalRetrans - entry.lastTotalRetrans;
+            stats.rttUs.add(info.rttUs);
+            stats.rttVarUs.add(info.rttVarUs);
+            stats.sndCwnd.add(info.sndCwnd);
+            stats.unacked.add(info.unacked);
+            if(info.deliveryRate > 0) {
+                stats.deliveryRate.add(info.deliveryRate);
+            }
+            entry.lastTotalRetrans = info.totalRetrans;
+        }
+        ++it;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    stats_.merge(stats);
+}
+
+TcpInfoStats TcpInfoSampler::snapshot() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+}   // namespace mymuduo
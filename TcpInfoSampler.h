@@ -0,0 +1,78 @@
+#ifndef _TCPINFOSAMPLER_H
+#define _TCPINFOSAMPLER_H
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Histogram.h"
+#include "TimerId.h"
+
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+
+namespace mymuduo {
+
+class EventLoop;
+
+// 采样得到的 TCP_INFO 统计
+struct TcpInfoStats {
+    TcpInfoStats() : samples(0), retransmits(0) {}
+
+    void merge(const TcpInfoStats &other);
+
+    uint64_t samples;           // 采样的次数（每个连接每次采样算一次）
+    uint64_t retransmits;       // 采样期间新增的重传报文段数
+    Histogram rttUs;
+    Histogram rttVarUs;
+    Histogram sndCwnd;
+    Histogram unacked;
+    Histogram deliveryRate;
+};
+
+/**
+ * 每个 EventLoop 一个的 TCP_INFO 采样器
+ * 每隔 interval 秒在 loop 线程中对登记的所有连接调用一次 getsockopt(TCP_INFO)，结果累积到直方图中
+ * 只保存连接的 weak_ptr；连接关闭时应该调用 remove 立即移除，
+ * 否则 weak_ptr 会让连接所在的内存块（allocate_shared 分配的对象和控制块）一直占用到下一次采样
+*/
+class TcpInfoSampler : noncopyable, public std::enable_shared_from_this<TcpInfoSampler> {
+public:
+    TcpInfoSampler(EventLoop *loop, double interval);
+    ~TcpInfoSampler();
+
+    // 开始定时采样，sampler 需要由 shared_ptr 管理
+    void start();
+
+    // 登记连接，可以在任意线程中调用
+    void add(const TcpConnectionPtr &conn);
+    // 移除连接，需要在 loop 线程中调用（如连接的 closeCallback 中）
+    void remove(const TcpConnectionPtr &conn);
+
+    // 到目前为止的统计结果，可以在任意线程中调用
+    TcpInfoStats snapshot() const;
+
+    EventLoop *getLoop() const { return loop_; }
+
+private:
+    struct Entry {
+        std::weak_ptr<TcpConnection> conn;
+        uint32_t lastTotalRetrans;
+    };
+
+    void addInLoop(const TcpConnectionPtr &conn);
+    void sample();
+
+    EventLoop *loop_;
+    const double interval_;
+    TimerId timer_;
+    bool started_;
+
+    std::unordered_map<const TcpConnection *, Entry> entries_;     // 只在 loop 线程中访问
+
+    mutable std::mutex mutex_;          // 保护 stats_
+    TcpInfoStats stats_;
+};
+
+}   // namespace mymuduo
+
+#endif
@@ -3,10 +3,89 @@
 #include "TcpConnection.h"
 
 #include <functional>
+#include <mutex>
 #include <strings.h>
 
 namespace mymuduo {
 
+// 获取 sockfd 绑定的本机的 ip 地址及端口信息
+static InetAddress getLocalAddr(int sockfd) {
+    sockaddr_in local;
+    ::bzero(&local, sizeof(local));
+    socklen_t addrlen = sizeof(local);
+    if(::getsockname(sockfd, (sockaddr *)&local, &addrlen) < 0) {
+        LOG_ERROR << "sockets::getLocalAddr";
+    }
+    return InetAddress(local);
+}
+
+/**
+ * 优雅关闭的进度：每个 loop 开始 drain 时登记自己的连接数，连接关闭时减一，
+ * 所有 loop 都登记过、并且所有连接都关闭以后，在 mainLoop 中回调 doneCallback
+*/
+struct TcpServer::DrainState {
+    DrainState(EventLoop *loop, size_t loops, const ConnectionCallback &drainCb, const ShutdownCallback &doneCb)
+        : mainLoop(loop),
+          drainCallback(drainCb),
+          doneCallback(doneCb),
+          pendingLoops(loops),
+          total(0),
+          remaining(0),
+          done(false) {}
+
+    // 在各个 subLoop 中调用
+    void addConnections(int64_t n) {
+        std::unique_lock<std::mutex> lock(mutex);
+        --pendingLoops;
+        total += n;
+        remaining += n;
+        checkDone();
+    }
+    void connectionClosed() {
+        std::unique_lock<std::mutex> lock(mutex);
+        --remaining;
+        checkDone();
+    }
+    void addKilled(int64_t n) {
+        std::unique_lock<std::mutex> lock(mutex);
+        stats.killed += n;
+    }
+    bool finished() {
+        std::unique_lock<std::mutex> lock(mutex);
+        return done;
+    }
+
+    // 需要持有 mutex
+    void checkDone() {
+        if(done || pendingLoops > 0 || remaining > 0) {
+            return ;
+        }
+        done = true;
+        stats.drained = total - stats.killed;
+        EventLoop *loop = mainLoop;
+        TimerId timer = deadlineTimer;
+        ShutdownCallback cb = doneCallback;
+        ShutdownStats result = stats;
+        mainLoop->queueInLoop([loop, timer, cb, result]() {
+            loop->cancel(timer);
+            if(cb) {
+                cb(result);
+            }
+        });
+    }
+
+    std::mutex mutex;
+    EventLoop *mainLoop;
+    const ConnectionCallback drainCallback;
+    const ShutdownCallback doneCallback;
+    TimerId deadlineTimer;      // 在 mainLoop 中设置，早于任何 checkDone 的回调执行
+    size_t pendingLoops;        // 还没有开始 drain 的 loop 数
+    int64_t total;
+    int64_t remaining;          // 还没有关闭的连接数
+    ShutdownStats stats;
+    bool done;
+};
+
 static EventLoop *CheckLoopNotNull(EventLoop *loop) {
     if(loop == nullptr) {
         LOG_FATAL << "mainLoop is null !";
@@ -18,15 +97,36 @@ TcpServer::TcpServer(EventLoop *loop,
                 const InetAddress &listenAddr,
                 const std::string &nameArg,
                 Option option)
-                : loop_(CheckLoopNotNull(loop)),
-                  ipPort_(listenAddr.toIpPort()),
+                : TcpServer(loop, new Acceptor(CheckLoopNotNull(loop), listenAddr, option == kReusePort),
+                            listenAddr.toIpPort(), nameArg) {}
+
+TcpServer::TcpServer(EventLoop *loop,
+                int listenfd,
+                const std::string &nameArg)
+                : TcpServer(loop, new Acceptor(CheckLoopNotNull(loop), listenfd),
+                            getLocalAddr(listenfd).toIpPort(), nameArg) {}
+
+TcpServer::TcpServer(EventLoop *loop,
+                Acceptor *acceptor,
+                const std::string &ipPort,
+                const std::string &nameArg)
+                : loop_(loop),
+                  ipPort_(ipPort),
                   name_(nameArg),
-                  acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+                  acceptor_(acceptor),
                   threadPool_(new EventLoopThreadPool(loop, name_)),
                   connectionCallback_(),
                   messageCallback_(),
+                  started_(0),
+                  shuttingDown_(false),
                   nextConnId_(1),
-                  started_(0) {
+                  connNamePrefix_(std::make_shared<const std::string>(nameArg + "-" + ipPort_)),
+                  writeTimeout_(0.0),
+                  maxOutputBytes_(0),
+                  readBudget_(0),
+                  connectionPriority_(kNormalPriority),
+                  slowConsumerEvictions_(std::make_shared<std::atomic<int64_t>>(0)),
+                  tcpInfoInterval_(0.0) {
 
     // 当有新用户连接时，会执行 TcpServer::newConnection 回调
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, 
@@ -34,13 +134,22 @@ TcpServer::TcpServer(EventLoop *loop,
 }
 
 TcpServer::~TcpServer() {
-    for(auto &item : connections_) {
+    // 连接表只能在各自的 loop 中访问，交给对应的 loop 去销毁其中的连接
+    for(size_t i = 0; i < ioLoops_.size(); i++) {
+        ioLoops_[i]->runInLoop(std::bind(&TcpServer::destroyConnectionsInLoop, loopConnections_[i]));
+    }
+}
+
+void TcpServer::destroyConnectionsInLoop(const ConnectionMapPtr &connections) {
+    ConnectionMap local;
+    local.swap(*connections);
+    for(auto &item : local) {
         // 这个局部的 shared_ptr 智能指针对象 conn，会自动释放 new 出来的 TcpConnection 对象资源
         TcpConnectionPtr conn(item.second);
         item.second.reset();
 
         // 销毁连接
-        conn->getLoop()->runInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+        conn->connectDestroyed();
     }
 }
 
@@ -53,60 +162,243 @@ void TcpServer::setThreadNum(int numThreads) {
 void TcpServer::start() {
     if(started_++ == 0) {   // 防止一个 TcpServer 对象对 start 多次
         threadPool_->start(threadInitCallback_);        // 启动底层的 loop 线程池（启动所有的 subLoop ）
+        ioLoops_ = threadPool_->getAllLoops();
+        for(EventLoop *ioLoop : ioLoops_) {
+            ConnectionMapPtr connections(std::make_shared<ConnectionMap>());
+            loopConnections_.push_back(connections);
+            std::shared_ptr<TcpInfoSampler> sampler;
+            if(tcpInfoInterval_ > 0.0) {
+                sampler.reset(new TcpInfoSampler(ioLoop, tcpInfoInterval_));
+                sampler->start();
+                tcpInfoSamplers_.push_back(sampler);
+            }
+            loopCallbacks_.push_back(makeCallbacks(connections, sampler));
+            loopTraffic_.push_back(std::make_shared<TrafficCounters>());
+            loopPools_.push_back(std::make_shared<BlockPool>());
+            if(readBudget_ > 0) {
+                ioLoop->runInLoop(std::bind(&EventLoop::setReadBudget, ioLoop, readBudget_));
+            }
+        }
         loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
     }
 }
 
+void TcpServer::shutdownGracefully(double timeoutSeconds,
+                            const ConnectionCallback &drainCallback,
+                            const ShutdownCallback &doneCallback) {
+    loop_->runInLoop(std::bind(&TcpServer::shutdownInLoop, this, timeoutSeconds, drainCallback, doneCallback),
+                     kHighPriority);
+}
+
+void TcpServer::shutdownInLoop(double timeoutSeconds, const ConnectionCallback &drainCallback,
+                            const ShutdownCallback &doneCallback) {
+    loop_->assertInLoopThread();
+    if(shuttingDown_) {
+        return ;
+    }
+    shuttingDown_ = true;
+    LOG_INFO << "TcpServer::shutdownGracefully [" << name_ << "] - timeout " << timeoutSeconds << "s";
+
+    // accept 队列中剩下的连接在这里交给 newConnection，它们登记到连接表的任务排在下面的 drain 之前
+    acceptor_->stopListening();
+
+    DrainStatePtr state(std::make_shared<DrainState>(loop_, ioLoops_.size(), drainCallback, doneCallback));
+    std::vector<EventLoop *> loops(ioLoops_);
+    std::vector<ConnectionMapPtr> connections(loopConnections_);
+    // 截止时间到了以后强制关闭剩下的连接，不捕获 this，连接都关闭之后这个定时器会被取消
+    state->deadlineTimer = loop_->runAfter(timeoutSeconds, [state, loops, connections]() {
+        if(state->finished()) {
+            return ;
+        }
+        for(size_t i = 0; i < loops.size(); i++) {
+            loops[i]->runInLoop(std::bind(&TcpServer::killConnectionsInLoop, connections[i], state), kHighPriority);
+        }
+    });
+
+    if(ioLoops_.empty()) {
+        // 还没有 start，没有任何连接
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->checkDone();
+        return ;
+    }
+    for(size_t i = 0; i < ioLoops_.size(); i++) {
+        ioLoops_[i]->runInLoop(std::bind(&TcpServer::drainConnectionsInLoop, loopConnections_[i], samplerOfLoop(i), state),
+                               kHighPriority);
+    }
+}
+
+void TcpServer::drainConnectionsInLoop(const ConnectionMapPtr &connections, const std::shared_ptr<TcpInfoSampler> &sampler,
+                                       const DrainStatePtr &state) {
+    // 回调中可能会关闭连接、修改连接表，先取出一份
+    std::vector<TcpConnectionPtr> conns;
+    conns.reserve(connections->size());
+    for(auto &item : *connections) {
+        conns.push_back(item.second);
+    }
+    state->addConnections(static_cast<int64_t>(conns.size()));
+
+    for(const TcpConnectionPtr &conn : conns) {
+        // 连接关闭时除了从连接表删除，还要通知 state
+        conn->setCloseCallback([connections, sampler, state](const TcpConnectionPtr &c) {
+            TcpServer::removeConnection(connections, sampler, c);
+            state->connectionClosed();
+        });
+        if(state->drainCallback) {
+            state->drainCallback(conn);
+        }
+    }
+    // 推迟到下一轮事件循环再关闭写端，先处理已经到达 socket 的请求（如刚刚在 stopListening 中 accept 的连接）
+    // outputBuffer_ 中的数据发送完以后才会真正关闭写端
+    if(!conns.empty()) {
+        conns.front()->getLoop()->queueInLoop([conns]() {
+            for(const TcpConnectionPtr &conn : conns) {
+                conn->shutdown();
+            }
+        });
+    }
+}
+
+void TcpServer::killConnectionsInLoop(const ConnectionMapPtr &connections, const DrainStatePtr &state) {
+    if(connections->empty()) {
+        return ;
+    }
+    LOG_INFO << "TcpServer::killConnectionsInLoop - force close " << connections->size() << " connections";
+    state->addKilled(static_cast<int64_t>(connections->size()));
+    std::vector<TcpConnectionPtr> conns;
+    for(auto &item : *connections) {
+        conns.push_back(item.second);
+    }
+    for(const TcpConnectionPtr &conn : conns) {
+        conn->forceClose();
+    }
+}
+
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr) {
     // 轮询算法，选择一个 subLoop，来管理 channel
     EventLoop *ioLoop = threadPool_->GetNextLoop();
-    char buf[64] = {0};
-    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
-    std::string connName = name_ + buf;
+    const uint64_t connId = nextConnId_++;
 
-    LOG_INFO << "TcpServer::newConnection [" << name_ <<  "] - new connection [" 
-             << connName << "]" << " from " <<peerAddr.toIpPort();
+    LOG_INFO << "TcpServer::newConnection [" << name_ <<  "] - new connection #"
+             << connId << " from " << peerAddr.toIpPort();
 
     // 通过 sockfd 获取其绑定的本机的 ip 地址及端口信息
-    sockaddr_in local;
-    ::bzero(&local, sizeof(local));
-    socklen_t addrlen = sizeof(local);
-    if(::getsockname(sockfd, (sockaddr *)&local, &addrlen) < 0) {
-        LOG_ERROR << "sockets::getLocalAddr";
+    InetAddress localAddr(getLocalAddr(sockfd));
+
+    // 根据连接成功的 sockfd，创建 TcpConnection 连接对象
+    // 连接对象、Socket、Channel、shared_ptr 控制块都在 ioLoop 内存池的同一个块中，连接关闭以后块回到池中
+    const size_t loopIndex = indexOfLoop(ioLoop);
+    TcpConnectionPtr conn = std::allocate_shared<TcpConnection>(PoolAllocator<TcpConnection>(loopPools_[loopIndex]),
+        ioLoop, connId, connNamePrefix_, sockfd, localAddr, peerAddr);
+
+    conn->setSocketOptions(socketOptions_);
+    conn->setTrafficAggregate(loopTraffic_[loopIndex]);
+    conn->setPriority(connectionPriority_);
+
+    // 用户设置给 TcpServer 的回调在 start 时已经放进了每个 loop 的回调表，这里只需要让连接引用这张表
+    // TcpConnection 再设置给 Channel，Channel 注册到 Poller 中，当 Poller 监听到对应的事件就会通知 Channel 调用回调
+    conn->setCallbacks(loopCallbacks_[loopIndex]);
+    if(writeTimeout_ > 0.0 || maxOutputBytes_ > 0) {
+        conn->setWriteDeadline(writeTimeout_, maxOutputBytes_);
     }
 
-    InetAddress localAddr(local);
+    // 在 subLoop 中登记到连接表，然后调用 TcpConnection::connectEstablished；建立连接是控制类任务，不排在数据处理后面
+    ioLoop->runInLoop(std::bind(&TcpServer::connectEstablishedInLoop, loopConnections_[loopIndex], conn), kHighPriority);
 
-    // 根据连接成功的 sockfd，创建 TcpConnection 连接对象
-    TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
+    if(!tcpInfoSamplers_.empty()) {
+        tcpInfoSamplers_[loopIndex]->add(conn);
+    }
+}
 
-    connections_[connName] = conn;
+TcpConnectionCallbacksPtr TcpServer::makeCallbacks(const ConnectionMapPtr &connections,
+                                                   const std::shared_ptr<TcpInfoSampler> &sampler) {
+    std::shared_ptr<TcpConnectionCallbacks> callbacks(std::make_shared<TcpConnectionCallbacks>());
+    callbacks->connectionCallback = connectionCallback_;
+    callbacks->messageCallback = messageCallback_;
+    callbacks->writeCompleteCallback = writeCompleteCallback_;
+    if(writeTimeout_ > 0.0 || maxOutputBytes_ > 0) {
+        callbacks->slowConsumerCallback = std::bind(&TcpServer::onSlowConsumer, slowConsumerEvictions_,
+                                                    std::placeholders::_1);
+    }
+    // 设置如何关闭连接的回调，关闭时直接在 subLoop 中从它的连接表和采样器中删除
+    callbacks->closeCallback = std::bind(&TcpServer::removeConnection, connections, sampler, std::placeholders::_1);
+    return callbacks;
+}
 
-    // 下面的回调都是用户设置给 TcpServer 的，然后 TcpServer 设置给 TcpConnection，TcpConnection 又设置给 Channel
-    // 然后 Channel 注册到 Poller 中，当 Poller 监听到对应的事件就会通知 Channel 调用回调
-    conn->setConnectionCallback(connectionCallback_);
-    conn->setMessageCallback(messageCallback_);
-    conn->setWriteCompleteCallback(writeCompleteCallback_);
-    
-    // 设置如何关闭连接的回调
-    conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
+void TcpServer::callbacksChanged() {
+    if(started_ > 0) {
+        loop_->runInLoop(std::bind(&TcpServer::rebuildCallbacksInLoop, this));
+    }
+}
 
-    // 直接调用 TcpConnection::connectEstablished
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+// newConnection 也在 mainLoop 中读取 loopCallbacks_，这里替换不需要加锁；已经建立的连接仍然持有原来的回调表
+void TcpServer::rebuildCallbacksInLoop() {
+    loop_->assertInLoopThread();
+    for(size_t i = 0; i < loopCallbacks_.size(); i++) {
+        loopCallbacks_[i] = makeCallbacks(loopConnections_[i], samplerOfLoop(i));
+    }
+}
+
+std::shared_ptr<TcpInfoSampler> TcpServer::samplerOfLoop(size_t loopIndex) const {
+    return tcpInfoSamplers_.empty() ? std::shared_ptr<TcpInfoSampler>() : tcpInfoSamplers_[loopIndex];
+}
+
+size_t TcpServer::indexOfLoop(EventLoop *ioLoop) const {
+    for(size_t i = 0; i < ioLoops_.size(); i++) {
+        if(ioLoops_[i] == ioLoop) {
+            return i;
+        }
+    }
+    return 0;
 }
 
-void TcpServer::removeConnection(const TcpConnectionPtr &conn) {
-    loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+TrafficStats TcpServer::trafficStats() const {
+    TrafficStats stats;
+    for(const std::shared_ptr<TrafficCounters> &counters : loopTraffic_) {
+        stats.merge(counters->snapshot());
+    }
+    return stats;
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn) {
-    LOG_INFO << "TcpServer::removeConnectionInLoop [" << name_ << "] - connection " << conn->name();
+std::vector<TrafficStats> TcpServer::trafficStatsPerLoop() const {
+    std::vector<TrafficStats> stats;
+    for(const std::shared_ptr<TrafficCounters> &counters : loopTraffic_) {
+        stats.push_back(counters->snapshot());
+    }
+    return stats;
+}
 
-    connections_.erase(conn->name());
+TcpInfoStats TcpServer::tcpInfoStats() const {
+    TcpInfoStats stats;
+    for(const std::shared_ptr<TcpInfoSampler> &sampler : tcpInfoSamplers_) {
+        stats.merge(sampler->snapshot());
+    }
+    return stats;
+}
+
+void TcpServer::onSlowConsumer(const EvictionCounterPtr &evictions, const TcpConnectionPtr &conn) {
+    int64_t total = ++*evictions;
+    // 连接的名字以 TcpServer 的名字开头
+    LOG_INFO << "TcpServer::onSlowConsumer - evict connection " << conn->name() << ", total evictions " << total;
+}
+
+void TcpServer::connectEstablishedInLoop(const ConnectionMapPtr &connections, const TcpConnectionPtr &conn) {
+    conn->getLoop()->assertInLoopThread();
+    (*connections)[conn->id()] = conn;
+    conn->connectEstablished();
+}
+
+void TcpServer::removeConnection(const ConnectionMapPtr &connections, const std::shared_ptr<TcpInfoSampler> &sampler,
+                                 const TcpConnectionPtr &conn) {
     EventLoop *ioLoop = conn->getLoop();
-    ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+    ioLoop->assertInLoopThread();
+    LOG_INFO << "TcpServer::removeConnection - connection " << conn->name();
 
+    connections->erase(conn->id());
+    // 采样器中的 weak_ptr 会让连接的内存块留到下一次采样才回到内存池，这里立即移除
+    if(sampler) {
+        sampler->remove(conn);
+    }
+    ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
 }
 
 }   // namespace mymuduo
\ No newline at end of file
@@ -9,11 +9,16 @@
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "TcpInfoSampler.h"
+#include "TrafficCounters.h"
+#include "BlockPool.h"
 
 #include <functional>
 #include <string>
 #include <atomic>
 #include <unordered_map>
+#include <vector>
+#include <memory>
 
 namespace mymuduo {
 
@@ -26,16 +31,74 @@ public:
         kReusePort,
     };
 
+    // 优雅关闭的结果
+    struct ShutdownStats {
+        ShutdownStats() : drained(0), killed(0) {}
+
+        int64_t drained;    // 截止时间之前正常关闭的连接数
+        int64_t killed;     // 到截止时间仍没有关闭、被强制关闭的连接数
+    };
+    using ShutdownCallback = std::function<void(const ShutdownStats&)>;
+
     TcpServer(EventLoop *loop,
                 const InetAddress &listenAddr,
                 const std::string &nameArg,
                 Option option = kNoReusePort);
+    /**
+     * 使用一个已经 bind 的监听 socket（如热重启时从旧进程收到的 fd），TcpServer 接管它的所有权
+    */
+    TcpServer(EventLoop *loop,
+                int listenfd,
+                const std::string &nameArg);
     ~TcpServer();
 
+    // 监听 socket 的 fd，热重启时交给新进程
+    int listenFd() const { return acceptor_->listenFd(); }
+
     void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
-    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
-    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
-    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+    /**
+     * 下面的回调在 start 时放进每个 loop 共享的回调表
+     * start 之后再设置会在 mainLoop 中重新生成回调表，对之后建立的连接生效，已经建立的连接继续使用原来的回调
+    */
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; callbacksChanged(); }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; callbacksChanged(); }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; callbacksChanged(); }
+
+    /**
+     * 慢消费者驱逐，对所有连接生效
+     * 待发送数据 writeTimeout 秒内没有发送完，或者 outputBuffer_ 超过 maxOutputBytes 字节，就强制关闭连接
+     * 参数为 0 表示不检查该项；和上面的回调一样，start 之后设置只对之后建立的连接生效
+    */
+    void setSlowConsumerLimits(double writeTimeout, size_t maxOutputBytes) {
+        writeTimeout_ = writeTimeout;
+        maxOutputBytes_ = maxOutputBytes;
+        callbacksChanged();
+    }
+    // 所有 subLoop 的读预算（EventLoop::setReadBudget），每个连接每轮最多读取 bytes 字节，需要在 start 之前设置
+    void setReadBudget(size_t bytes) { readBudget_ = bytes; }
+    // 新连接的 channel 优先级（TcpConnection::setPriority），例如管理端口用 kHighPriority，需要在 start 之前设置
+    void setConnectionPriority(EventPriority priority) { connectionPriority_ = priority; }
+    // 监听 socket 的选项（backlog、TCP_DEFER_ACCEPT、TCP_FASTOPEN），需要在 start 之前设置
+    void setListenOptions(const ListenOptions &options) { acceptor_->setListenOptions(options); }
+
+    // 新连接的 socket 选项，如 SocketOptions::lowLatency()
+    void setSocketOptions(const SocketOptions &options) { socketOptions_ = options; }
+
+    /**
+     * 开启 TCP_INFO 采样：start 时给每个 loop 创建一个 TcpInfoSampler，每隔 interval 秒采样一次该 loop 上的所有连接
+     * 需要在 start 之前调用
+    */
+    void enableTcpInfoSampling(double interval) { tcpInfoInterval_ = interval; }
+    // 所有 loop 的采样结果之和，可以在任意线程中调用
+    TcpInfoStats tcpInfoStats() const;
+
+    // 所有连接的流量统计之和，可以在任意线程中调用（start 之后）
+    TrafficStats trafficStats() const;
+    // 每个 loop 上的流量统计，顺序和 EventLoopThreadPool::getAllLoops() 相同
+    std::vector<TrafficStats> trafficStatsPerLoop() const;
+
+    // 因为慢消费者被驱逐的连接数
+    int64_t slowConsumerEvictions() const { return *slowConsumerEvictions_; }
 
     // 设置 subLoop 的个数
     void setThreadNum(int numThreads);
@@ -43,12 +106,57 @@ public:
     // 开启服务器监听
     void start();
 
+    /**
+     * 优雅关闭，可以在任意线程中调用，只有第一次调用生效：
+     *      1. 停止监听，已经完成握手的连接仍然会被接收
+     *      2. 在每个连接所在的 loop 中调用 drainCallback（可以为空），用户可以在里面发送最后的响应、不再处理新请求
+     *      3. 每个连接发送完已经积压的数据后关闭写端，等待对端关闭连接
+     *      4. timeoutSeconds 秒后仍然没有关闭的连接被强制关闭
+     * 所有连接都关闭以后在 mainLoop 中调用 doneCallback，TcpServer 至少要存活到这个时候
+    */
+    void shutdownGracefully(double timeoutSeconds,
+                            const ConnectionCallback &drainCallback,
+                            const ShutdownCallback &doneCallback);
+
 private:
-    void newConnection(int sockfd, const InetAddress &peerAddr);
-    void removeConnection(const TcpConnectionPtr &conn);
-    void removeConnectionInLoop(const TcpConnectionPtr &conn);
+    TcpServer(EventLoop *loop,
+                Acceptor *acceptor,
+                const std::string &ipPort,
+                const std::string &nameArg);
 
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    // 每个 loop 一张连接表，只在该 loop 的线程中访问
+    using ConnectionMap = std::unordered_map<uint64_t, TcpConnectionPtr>;
+    using ConnectionMapPtr = std::shared_ptr<ConnectionMap>;
+    // 一次优雅关闭的进度，由各个 loop 共享
+    struct DrainState;
+    using DrainStatePtr = std::shared_ptr<DrainState>;
+
+    void newConnection(int sockfd, const InetAddress &peerAddr);
+    // 下面三个函数都在连接所在的 subLoop 中执行，只访问该 loop 的连接表，关闭连接时不需要经过 mainLoop
+    // 连接表由 shared_ptr 管理，TcpServer 析构以后仍然有效
+    static void connectEstablishedInLoop(const ConnectionMapPtr &connections, const TcpConnectionPtr &conn);
+    // sampler 不为空时同时从该 loop 的 TCP_INFO 采样器中移除连接
+    static void removeConnection(const ConnectionMapPtr &connections, const std::shared_ptr<TcpInfoSampler> &sampler,
+                                 const TcpConnectionPtr &conn);
+    static void destroyConnectionsInLoop(const ConnectionMapPtr &connections);
+    // 优雅关闭：在 mainLoop 中停止监听，然后在各个 subLoop 中关闭 / 强制关闭连接
+    void shutdownInLoop(double timeoutSeconds, const ConnectionCallback &drainCallback,
+                        const ShutdownCallback &doneCallback);
+    static void drainConnectionsInLoop(const ConnectionMapPtr &connections, const std::shared_ptr<TcpInfoSampler> &sampler,
+                                       const DrainStatePtr &state);
+    static void killConnectionsInLoop(const ConnectionMapPtr &connections, const DrainStatePtr &state);
+    // 在 subLoop 中调用；回调表可能比 TcpServer 活得更久，所以不能访问 this，计数器由回调表共同持有
+    using EvictionCounterPtr = std::shared_ptr<std::atomic<int64_t>>;
+    static void onSlowConsumer(const EvictionCounterPtr &evictions, const TcpConnectionPtr &conn);
+    // 生成某个 loop 共享的回调表
+    TcpConnectionCallbacksPtr makeCallbacks(const ConnectionMapPtr &connections, const std::shared_ptr<TcpInfoSampler> &sampler);
+    // 第 loopIndex 个 loop 的采样器，没有开启采样时为空
+    std::shared_ptr<TcpInfoSampler> samplerOfLoop(size_t loopIndex) const;
+    // start 之后修改了回调，在 mainLoop 中重新生成 loopCallbacks_
+    void callbacksChanged();
+    void rebuildCallbacksInLoop();
+    // ioLoop 在 ioLoops_ 中的下标
+    size_t indexOfLoop(EventLoop *ioLoop) const;
 
     // 用户定义的 loop（baseLoop）
     EventLoop *loop_;
@@ -64,9 +172,32 @@ private:
 
     ThreadInitCallback threadInitCallback_;             // loop 线程初始化的回调
     std::atomic_int started_;
-
-    int nextConnId_;
-    ConnectionMap connections_;                         // 保存所有的连接
+    bool shuttingDown_;                                 // 只在 mainLoop 中访问
+
+    uint64_t nextConnId_;                               // 只在 mainLoop 中访问
+    // 连接名字的公共前缀 "name-ip:port"，所有连接共享一份，连接的名字是 "前缀#id"
+    const std::shared_ptr<const std::string> connNamePrefix_;
+
+    SocketOptions socketOptions_;
+    double writeTimeout_;
+    size_t maxOutputBytes_;
+    size_t readBudget_;
+    EventPriority connectionPriority_;
+    const EvictionCounterPtr slowConsumerEvictions_;
+
+    // 下面几个数组一一对应，start 以后不再修改
+    std::vector<EventLoop *> ioLoops_;
+    std::vector<ConnectionMapPtr> loopConnections_;
+    // 每个 loop 一份，只由该 loop 上的连接更新，不同 loop 之间没有竞争
+    std::vector<std::shared_ptr<TrafficCounters>> loopTraffic_;
+    // 每个 loop 一张回调表，该 loop 上的所有连接共享，closeCallback 绑定的是该 loop 的连接表
+    std::vector<TcpConnectionCallbacksPtr> loopCallbacks_;
+    // 每个 loop 一个 TcpConnection 的内存池，连接对象和 shared_ptr 控制块一起从池中分配
+    std::vector<std::shared_ptr<BlockPool>> loopPools_;
+
+    double tcpInfoInterval_;
+    // 定义在 threadPool_ 之后，保证在 subLoop 析构之前析构
+    std::vector<std::shared_ptr<TcpInfoSampler>> tcpInfoSamplers_;
 };
 
 }   // namespace mymuduo
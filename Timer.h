@@ -0,0 +1,45 @@
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+
+#include <atomic>
+
+namespace mymuduo {
+
+// 定时器，记录到期时间和到期以后执行的回调，interval 大于 0 时为周期定时器
+class Timer : noncopyable {
+public:
+    Timer(TimerCallback cb, Timestamp when, double interval)
+        : callback_(std::move(cb)),
+          expiration_(when),
+          interval_(interval),
+          repeat_(interval > 0.0),
+          sequence_(++s_numCreated_) {}
+
+    void run() const { callback_(); }
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    // 周期定时器到期以后，从 now 开始计算下一次的到期时间
+    void restart(Timestamp now);
+
+    static int64_t numCreated() { return s_numCreated_; }
+
+private:
+    const TimerCallback callback_;
+    Timestamp expiration_;
+    const double interval_;     // 周期，单位为秒
+    const bool repeat_;
+    const int64_t sequence_;    // 全局唯一的序号，用来区分地址相同的新旧定时器
+
+    static std::atomic<int64_t> s_numCreated_;
+};
+
+}   // namespace mymuduo
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef _TIMERQUEUE_H
+#define _TIMERQUEUE_H
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+
+#include <set>
+#include <vector>
+#include <utility>
+
+namespace mymuduo {
+
+class EventLoop;
+class Timer;
+class TimerId;
+
+/**
+ * 定时器队列，每个 EventLoop 一个
+ * 所有定时器按到期时间排序，只用一个 timerfd 设置最早的到期时间，timerfd 可读时在 loop 线程中执行到期的回调
+*/
+class TimerQueue : noncopyable {
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // 添加定时器，可以在任意线程中调用
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    // 取消定时器，可以在任意线程中调用
+    void cancel(TimerId timerId);
+
+private:
+    using Entry = std::pair<Timestamp, Timer *>;
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer *, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+    // timerfd 可读时的回调
+    void handleRead();
+    // 取出所有到期的定时器
+    std::vector<Entry> getExpired(Timestamp now);
+    // 重新插入周期定时器，并根据最早的到期时间重置 timerfd
+    void reset(const std::vector<Entry> &expired, Timestamp now);
+
+    bool insert(Timer *timer);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+
+    TimerList timers_;                  // 按到期时间排序
+    ActiveTimerSet activeTimers_;       // 和 timers_ 中的定时器相同，按地址排序，用于 cancel
+
+    bool callingExpiredTimers_;
+    ActiveTimerSet cancelingTimers_;    // 在到期回调中被取消的周期定时器，不再重新插入
+};
+
+}   // namespace mymuduo
+
+#endif
@@ -1,5 +1,6 @@
 #include "Timestamp.h"
 #include <time.h>
+#include <sys/time.h>
 
 namespace mymuduo {
 
@@ -9,12 +10,15 @@ Timestamp::Timestamp(int64_t microSecondSinceEpoch)
     : microSecondSinceEpoch_(microSecondSinceEpoch) {}
 
 Timestamp Timestamp::now() {
-    return Timestamp(time(NULL));
+    struct timeval tv;
+    ::gettimeofday(&tv, nullptr);
+    return Timestamp(static_cast<int64_t>(tv.tv_sec) * kMicroSecondsPerSecond + tv.tv_usec);
 }
 
 std::string Timestamp::toString() const {
     char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondSinceEpoch_);
+    time_t seconds = secondsSinceEpoch();
+    tm *tm_time = localtime(&seconds);
     snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d", 
         tm_time->tm_year + 1900,
         tm_time->tm_mon + 1,
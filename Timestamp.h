@@ -2,21 +2,50 @@
 #define _TIMESTAMP_H
 
 #include <iostream>
+#include <stdint.h>
+#include <time.h>
 
 namespace mymuduo {
 
-// 时间类
+// 时间类，精度为微秒
 class Timestamp {
 public:
 	Timestamp();
 	explicit Timestamp(int64_t microSecondSinceEpoch);
 	static Timestamp now();
+	static Timestamp invalid() { return Timestamp(); }
 	std::string toString() const;
 
+	bool valid() const { return microSecondSinceEpoch_ > 0; }
+	int64_t microSecondsSinceEpoch() const { return microSecondSinceEpoch_; }
+	time_t secondsSinceEpoch() const { return static_cast<time_t>(microSecondSinceEpoch_ / kMicroSecondsPerSecond); }
+
+	static const int kMicroSecondsPerSecond = 1000 * 1000;
+
 private:
 	int64_t microSecondSinceEpoch_;
 };
 
+inline bool operator<(Timestamp lhs, Timestamp rhs) {
+	return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs) {
+	return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 两个时间点相差的秒数
+inline double timeDifference(Timestamp high, Timestamp low) {
+	int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+	return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// timestamp 加上 seconds 秒
+inline Timestamp addTime(Timestamp timestamp, double seconds) {
+	int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+	return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
+
 }	// namespace mymuduo
 
 #endif
@@ -0,0 +1,145 @@
+#include "TrafficCounters.h"
+
+namespace mymuduo {
+
+void TrafficStats::merge(const TrafficStats &other) {
+    bytesIn += other.bytesIn;
+    bytesOut += other.bytesOut;
+    messagesIn += other.messagesIn;
+    messagesOut += other.messagesOut;
+    readCalls += other.readCalls;
+    writeCalls += other.writeCalls;
+    eagainCount += other.eagainCount;
+    if(other.maxOutputBufferBytes > maxOutputBufferBytes) {
+        maxOutputBufferBytes = other.maxOutputBufferBytes;
+    }
+    readBudgetHits += other.readBudgetHits;
+    activeConnections += other.activeConnections;
+    totalConnections += other.totalConnections;
+    connectedSeconds += other.connectedSeconds;
+}
+
+TrafficCounters::TrafficCounters()
+    : sequence_(0),
+      bytesIn_(0),
+      bytesOut_(0),
+      messagesIn_(0),
+      messagesOut_(0),
+      readCalls_(0),
+      writeCalls_(0),
+      eagainCount_(0),
+      maxOutputBufferBytes_(0),
+      readBudgetHits_(0),
+      activeConnections_(0),
+      totalConnections_(0),
+      connectedMicroSeconds_(0),
+      closedMicroSeconds_(0) {}
+
+void TrafficCounters::beginUpdate() {
+    sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void TrafficCounters::endUpdate() {
+    sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void TrafficCounters::onRead(ssize_t n) {
+    beginUpdate();
+    bump(readCalls_, 1);
+    if(n > 0) {
+        bump(bytesIn_, n);
+    }
+    endUpdate();
+}
+
+void TrafficCounters::onWrite(ssize_t n) {
+    beginUpdate();
+    bump(writeCalls_, 1);
+    if(n > 0) {
+        bump(bytesOut_, n);
+    }
+    endUpdate();
+}
+
+void TrafficCounters::onEagain() {
+    beginUpdate();
+    bump(eagainCount_, 1);
+    endUpdate();
+}
+
+void TrafficCounters::onMessageIn() {
+    beginUpdate();
+    bump(messagesIn_, 1);
+    endUpdate();
+}
+
+void TrafficCounters::onMessageOut() {
+    beginUpdate();
+    bump(messagesOut_, 1);
+    endUpdate();
+}
+
+void TrafficCounters::onOutputBuffered(size_t bytes) {
+    if(bytes > maxOutputBufferBytes_.load(std::memory_order_relaxed)) {
+        beginUpdate();
+        maxOutputBufferBytes_.store(bytes, std::memory_order_relaxed);
+        endUpdate();
+    }
+}
+
+void TrafficCounters::onReadBudgetHit() {
+    beginUpdate();
+    bump(readBudgetHits_, 1);
+    endUpdate();
+}
+
+void TrafficCounters::onConnected(Timestamp when) {
+    beginUpdate();
+    bump(activeConnections_, 1);
+    bump(totalConnections_, 1);
+    bump(connectedMicroSeconds_, when.microSecondsSinceEpoch());
+    endUpdate();
+}
+
+void TrafficCounters::onDisconnected(Timestamp connectedAt, Timestamp when) {
+    beginUpdate();
+    bump(activeConnections_, static_cast<uint64_t>(-1));
+    bump(connectedMicroSeconds_, static_cast<uint64_t>(-connectedAt.microSecondsSinceEpoch()));
+    bump(closedMicroSeconds_, when.microSecondsSinceEpoch() - connectedAt.microSecondsSinceEpoch());
+    endUpdate();
+}
+
+TrafficStats TrafficCounters::snapshot() const {
+    TrafficStats stats;
+    uint64_t connectedSince = 0;
+    uint64_t closed = 0;
+    uint32_t before, after;
+    do {
+        before = sequence_.load(std::memory_order_acquire);
+        stats.bytesIn = bytesIn_.load(std::memory_order_relaxed);
+        stats.bytesOut = bytesOut_.load(std::memory_order_relaxed);
+        stats.messagesIn = messagesIn_.load(std::memory_order_relaxed);
+        stats.messagesOut = messagesOut_.load(std::memory_order_relaxed);
+        stats.readCalls = readCalls_.load(std::memory_order_relaxed);
+        stats.writeCalls = writeCalls_.load(std::memory_order_relaxed);
+        stats.eagainCount = eagainCount_.load(std::memory_order_relaxed);
+        stats.maxOutputBufferBytes = maxOutputBufferBytes_.load(std::memory_order_relaxed);
+        stats.readBudgetHits = readBudgetHits_.load(std::memory_order_relaxed);
+        stats.activeConnections = static_cast<int64_t>(activeConnections_.load(std::memory_order_relaxed));
+        stats.totalConnections = totalConnections_.load(std::memory_order_relaxed);
+        connectedSince = connectedMicroSeconds_.load(std::memory_order_relaxed);
+        closed = closedMicroSeconds_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = sequence_.load(std::memory_order_relaxed);
+    } while((before & 1) || before != after);
+
+    // 每个当前连接的时长 = now - 建立时间，求和就是 active * now - 建立时间之和
+    // 按无符号数计算，中间结果溢出也能得到正确的差值
+    uint64_t total = static_cast<uint64_t>(stats.activeConnections)
+                     * static_cast<uint64_t>(Timestamp::now().microSecondsSinceEpoch()) - connectedSince + closed;
+    stats.connectedSeconds = static_cast<double>(total) / Timestamp::kMicroSecondsPerSecond;
+    return stats;
+}
+
+}   // namespace mymuduo
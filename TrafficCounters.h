@@ -0,0 +1,89 @@
+#ifndef _TRAFFICCOUNTERS_H
+#define _TRAFFICCOUNTERS_H
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+namespace mymuduo {
+
+// 流量统计的快照
+struct TrafficStats {
+    TrafficStats()
+        : bytesIn(0), bytesOut(0), messagesIn(0), messagesOut(0),
+          readCalls(0), writeCalls(0), eagainCount(0), maxOutputBufferBytes(0),
+          readBudgetHits(0), activeConnections(0), totalConnections(0), connectedSeconds(0.0) {}
+
+    // 累加 other，maxOutputBufferBytes 取两者的最大值
+    void merge(const TrafficStats &other);
+
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint64_t messagesIn;            // messageCallback 的调用次数
+    uint64_t messagesOut;           // send / sendFile 的调用次数
+    uint64_t readCalls;             // read / splice 等读 socket 的系统调用次数
+    uint64_t writeCalls;            // write / writev / sendfile / splice 等写 socket 的系统调用次数
+    uint64_t eagainCount;           // 读写 socket 返回 EAGAIN 的次数
+    uint64_t maxOutputBufferBytes;  // outputBuffer_ 积压的最大字节数
+    uint64_t readBudgetHits;        // 一次读满 EventLoop::readBudget() 的次数，剩下的数据留到下一轮
+    int64_t activeConnections;      // 当前的连接数（单个连接为 0 或 1）
+    uint64_t totalConnections;      // 建立过的连接总数
+    double connectedSeconds;        // 连接时长之和（包括已经关闭的连接），单个连接就是它的连接时长
+};
+
+/**
+ * 流量计数器，只能由一个线程（连接所在的 loop 线程）写，任意线程都可以读
+ * 写入时不加锁，也没有原子的读-改-写指令；通过序号（seqlock）保证 snapshot 读到的是某次更新完成后的一致状态
+*/
+class TrafficCounters : noncopyable {
+public:
+    TrafficCounters();
+
+    void onRead(ssize_t n);             // 一次读系统调用，n 为返回值
+    void onWrite(ssize_t n);            // 一次写系统调用，n 为返回值
+    void onEagain();
+    void onMessageIn();
+    void onMessageOut();
+    void onOutputBuffered(size_t bytes);
+    void onReadBudgetHit();
+    void onConnected(Timestamp when);
+    void onDisconnected(Timestamp connectedAt, Timestamp when);
+
+    // 可以在任意线程中调用
+    TrafficStats snapshot() const;
+
+private:
+    using Counter = std::atomic<uint64_t>;
+
+    // 单写者，不需要 fetch_add
+    static void bump(Counter &counter, uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    void beginUpdate();
+    void endUpdate();
+
+    std::atomic<uint32_t> sequence_;    // 奇数表示正在更新
+    Counter bytesIn_;
+    Counter bytesOut_;
+    Counter messagesIn_;
+    Counter messagesOut_;
+    Counter readCalls_;
+    Counter writeCalls_;
+    Counter eagainCount_;
+    Counter maxOutputBufferBytes_;
+    Counter readBudgetHits_;
+    Counter activeConnections_;
+    Counter totalConnections_;
+    // 所有当前连接的建立时间之和（微秒），用来计算当前连接的时长之和
+    Counter connectedMicroSeconds_;
+    // 已经关闭的连接的时长之和（微秒）
+    Counter closedMicroSeconds_;
+};
+
+}   // namespace mymuduo
+
+#endif
@@ -0,0 +1,87 @@
+#include "mymuduo/Buffer.h"
+#include "mymuduo/Timestamp.h"
+#include "codec.h"
+
+// #include "Buffer.h"
+
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+using namespace mymuduo;
+
+/**
+ * 统计 Codec::onMessage 解码每条消息的堆分配次数
+ * copy：旧的方式，每条消息构造一个 std::string 交给回调
+ * slice：回调直接拿到指向 Buffer 的 StringPiece
+*/
+static std::atomic<size_t> g_allocations(0);
+
+void *operator new(size_t size) {
+    g_allocations++;
+    void *p = ::malloc(size);
+    if(p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    ::free(p);
+}
+
+static void fill(Buffer *buf, int count, size_t msgLen) {
+    std::string payload(msgLen, 'm');
+    for(int i = 0; i < count; i++) {
+        buf->appendInt32(static_cast<int32_t>(msgLen));
+        buf->append(payload.data(), payload.size());
+    }
+}
+
+// 旧版 Codec 的解码方式
+static size_t decodeCopy(Buffer *buf) {
+    size_t bytes = 0;
+    while(buf->readableBytes() >= sizeof(int32_t)) {
+        int32_t len = buf->peekInt32();
+        if(buf->readableBytes() < len + sizeof(int32_t)) {
+            break;
+        }
+        buf->retrieve(sizeof(int32_t));
+        std::string message(buf->peek(), len);
+        bytes += message.size();
+        buf->retrieve(len);
+    }
+    return bytes;
+}
+
+// ./bench [count] [msgLen]
+int main(int argc, char **argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 100000;
+    size_t msgLen = argc > 2 ? atoi(argv[2]) : 64;
+
+    size_t bytes = 0;
+    Codec codec([&bytes](const TcpConnectionPtr &, const StringPiece &msg, Timestamp) {
+        bytes += msg.size();
+    });
+
+    Buffer copyBuf;
+    fill(&copyBuf, count, msgLen);
+    size_t before = g_allocations;
+    size_t copied = decodeCopy(&copyBuf);
+    size_t copyAllocs = g_allocations - before;
+
+    Buffer sliceBuf;
+    fill(&sliceBuf, count, msgLen);
+    TcpConnectionPtr conn;
+    before = g_allocations;
+    codec.onMessage(conn, &sliceBuf, Timestamp());
+    size_t sliceAllocs = g_allocations - before;
+
+    std::cout << "messages = " << count << ", msgLen = " << msgLen << std::endl;
+    std::cout << "copy : " << static_cast<double>(copyAllocs) / count << " allocations/msg, " << copied << " bytes" << std::endl;
+    std::cout << "slice: " << static_cast<double>(sliceAllocs) / count << " allocations/msg, " << bytes << " bytes" << std::endl;
+
+    return 0;
+}
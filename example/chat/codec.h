@@ -4,35 +4,35 @@
 #include "mymuduo/TcpConnection.h"
 #include "mymuduo/Logger.h"
 #include "mymuduo/Buffer.h"
+#include "mymuduo/ByteOrder.h"
 
 #include <functional>
+#include <vector>
 
 using namespace mymuduo;
 
 class Codec : noncopyable {
 public:
+    // msg 直接指向 inputBuffer_ 中的数据，回调返回后失效，需要保留时调用 msg.asString() 拷贝
     using StringMsgCallback = std::function<void(const TcpConnectionPtr &, 
-                                                 const std::string &msg,
+                                                 const StringPiece &msg,
                                                  Timestamp)>;
 
     explicit Codec(const StringMsgCallback &cb) : messageCallback_(cb) {}
     
     void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp time) {
         while(buf->readableBytes() >= kHeaderLen) {
-            const void *data = buf->peek();
-            int32_t nw32 = *static_cast<const int32_t *>(data);
-            int32_t len = ntohl(nw32);
-            // int32_t len = __bswap_32 (nw32);
+            // peek() 不保证 4 字节对齐，不能直接解引用成 int32_t
+            int32_t len = endian::loadBE<int32_t>(buf->peek());
 
-            LOG_INFO << "[recv msg] len = " << len << ", nw32 = " << nw32;
+            LOG_INFO << "[recv msg] len = " << len;
 
             if(len > 65536 || len < 0) {
                 LOG_ERROR << "Invalid length = " << len;
                 conn->shutdown();
             } else if(buf->readableBytes() >= len + kHeaderLen) {
                 buf->retrieve(kHeaderLen);
-                std::string message(buf->peek(), len);
-                messageCallback_(conn, message, time);
+                messageCallback_(conn, StringPiece(buf->peek(), len), time);
                 buf->retrieve(len);
             } else {
                 break;
@@ -40,18 +40,18 @@ public:
         }
     }
 
-    void send(TcpConnection *conn, const std::string &data) {
-        Buffer buf;
-        buf.append(data.c_str(), data.size());
+    void send(TcpConnection *conn, const StringPiece &data) {
         int32_t len = data.size();
         // int32_t nw32 = __bswap_32 (len);
         int32_t nw32 = htonl(len);
-        buf.prepend(&nw32, sizeof(nw32));
-        std::string message = buf.retrieveAllAsString();
 
-        LOG_INFO << "[send msg] len = " << message.size() << ", nw32 = " << nw32;
+        LOG_INFO << "[send msg] len = " << kHeaderLen + len << ", nw32 = " << nw32;
 
-        conn->send(message);
+        // header 和 payload 作为两个片段通过一次 writev 发送，不再拼接成一个新的 string
+        std::vector<StringPiece> slices;
+        slices.push_back(StringPiece(&nw32, sizeof(nw32)));
+        slices.push_back(data);
+        conn->send(slices);
     }
 
 private:
@@ -64,7 +64,7 @@ private:
         }
     }
 
-    void onMessage(const TcpConnectionPtr &conn, const std::string &msg, Timestamp time) {
+    void onMessage(const TcpConnectionPtr &conn, const StringPiece &msg, Timestamp time) {
         cout << "recv msg = " << msg << endl;
         // conn->shutdown();
     }
@@ -45,12 +45,14 @@ private:
     
     // 可读写事件回调
     void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp time) {
-        std::string msg = buf->retrieveAllAsString();
+        // 直接引用 inputBuffer_ 中的数据，只有发给其它 loop 上的连接时才会拷贝
+        StringPiece msg = buf->toStringPiece();
         std::cout << "Server recv msg = " << msg << ", n = " << msg.size() << std::endl;
         
         for(auto it = connections_.begin(); it != connections_.end(); it++) {
-            (*it)->send(msg);
+            (*it)->send(msg.data(), msg.size());
         }
+        buf->retrieveAll();
     }
 
     using ConnectionList = std::set<TcpConnectionPtr>;
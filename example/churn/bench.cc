@@ -0,0 +1,115 @@
+#include "mymuduo/TcpServer.h"
+#include "mymuduo/EventLoopThread.h"
+
+// #include "TcpServer.h"
+// #include "EventLoopThread.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace mymuduo;
+
+/**
+ * 连接建立 / 关闭的压力测试：clients 个线程各自循环 connect + close，服务端不收发数据
+ * 统计每秒处理的连接数，以及平均每个连接的 operator new 次数（整个进程，客户端只用原始 socket，不会 new）
+ * 注意 Buffer 的内存用 malloc 分配，不计入这里的次数
+*/
+static std::atomic<size_t> g_allocations(0);
+
+void *operator new(size_t size) {
+    g_allocations++;
+    void *p = ::malloc(size);
+    if(p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    ::free(p);
+}
+
+static void runClient(uint16_t port, int count) {
+    InetAddress addr(port, "127.0.0.1");
+    for(int i = 0; i < count; i++) {
+        int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if(::connect(sockfd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+            ::close(sockfd);
+            ::usleep(1000);
+            --i;
+            continue;
+        }
+        ::close(sockfd);
+    }
+}
+
+// ./bench [connections] [clients] [threads] [port] [tcpInfoInterval]
+// tcpInfoInterval > 0 时开启 TCP_INFO 采样，用来确认采样不会让连接的内存块错过内存池
+int main(int argc, char **argv) {
+    int connections = argc > 1 ? atoi(argv[1]) : 10000;
+    int clients = argc > 2 ? atoi(argv[2]) : 4;
+    int threads = argc > 3 ? atoi(argv[3]) : 2;
+    uint16_t port = argc > 4 ? atoi(argv[4]) : 9999;
+    double tcpInfoInterval = argc > 5 ? atof(argv[5]) : 0.0;
+
+    EventLoopThread loopThread;
+    TcpServer server(loopThread.startLoop(), InetAddress(port), "ChurnBench");
+    server.setThreadNum(threads);
+    if(tcpInfoInterval > 0.0) {
+        server.enableTcpInfoSampling(tcpInfoInterval);
+    }
+
+    std::atomic<int> up(0);
+    std::atomic<int> down(0);
+    server.setConnectionCallback([&up, &down](const TcpConnectionPtr &conn) {
+        if(conn->connected()) {
+            ++up;
+        } else {
+            ++down;
+        }
+    });
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+        buf->retrieveAll();
+    });
+    server.start();
+
+    // 先建立一轮连接，让内存池和各个容器进入稳定状态
+    runClient(port, clients);
+    while(down < clients) {
+        ::usleep(1000);
+    }
+
+    const int perClient = connections / clients;
+    const int total = perClient * clients;
+    const int baseline = down;
+    size_t before = g_allocations;
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for(int i = 0; i < clients; i++) {
+        workers.emplace_back(runClient, port, perClient);
+    }
+    for(std::thread &t : workers) {
+        t.join();
+    }
+    while(down - baseline < total) {
+        ::usleep(1000);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    size_t allocations = g_allocations - before;
+
+    std::cout << total << " connections, " << clients << " clients, " << threads << " io threads" << std::endl;
+    std::cout << total / elapsed.count() << " connections/s, "
+              << static_cast<double>(allocations) / total << " allocations/connection" << std::endl;
+
+    return 0;
+}
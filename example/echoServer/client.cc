@@ -58,8 +58,8 @@ private:
     }
 
     void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp time) {
-        std::string msg = buf->retrieveAllAsString();
-        cout << "recv msg = " << msg << endl;
+        cout << "recv msg = " << buf->toStringPiece() << endl;
+        buf->retrieveAll();
         // conn->shutdown();
     }
 
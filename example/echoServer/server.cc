@@ -42,8 +42,9 @@ private:
     
     // 可读写事件回调
     void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp time) {
-        std::string msg = buf->retrieveAllAsString();
-        conn->send(msg);
+        // onMessage 运行在 conn 所在的 loop 线程，send 直接写 inputBuffer_ 中的数据，不经过 std::string
+        conn->send(buf->peek(), buf->readableBytes());
+        buf->retrieveAll();
         // conn->shutdown();
     }
 
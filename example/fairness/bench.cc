@@ -0,0 +1,134 @@
+#include "mymuduo/TcpServer.h"
+#include "mymuduo/EventLoopThread.h"
+
+// #include "TcpServer.h"
+// #include "EventLoopThread.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace mymuduo;
+
+/**
+ * 读预算的公平性测试：所有连接在同一个 loop 上，bulkClients 个连接不停地发送大块数据，
+ * 一个 ping 连接每次发送 "p\n" 并等待服务端回复 "\n"，统计 ping 的往返延迟
+ * 服务端对收到的每个字节做一点计算（模拟协议解析），每遇到一个 '\n' 回复一个 '\n'，bulk 数据中没有 '\n'
+ *
+ * 分别用 budget = 0（不限制）和 budget = 16384 运行，对比 ping 的 p50 / p99，以及读满预算的次数
+*/
+static uint32_t g_sink = 0;
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+    const char *data = buf->peek();
+    const size_t len = buf->readableBytes();
+    uint32_t hash = g_sink;
+    int replies = 0;
+    for(size_t i = 0; i < len; i++) {
+        for(int round = 0; round < 8; round++) {
+            hash = hash * 31 + static_cast<unsigned char>(data[i]);
+        }
+        if(data[i] == '\n') {
+            ++replies;
+        }
+    }
+    g_sink = hash;
+    buf->retrieveAll();
+    if(replies > 0) {
+        conn->send(std::string(replies, '\n'));
+    }
+}
+
+static int connectTo(uint16_t port) {
+    InetAddress addr(port, "127.0.0.1");
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if(::connect(sockfd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+        ::close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+static void runBulk(uint16_t port, const std::atomic<bool> *stop) {
+    int sockfd = connectTo(port);
+    if(sockfd < 0) {
+        return ;
+    }
+    std::string chunk(256 * 1024, 'x');
+    while(!*stop) {
+        if(::send(sockfd, chunk.data(), chunk.size(), MSG_NOSIGNAL) <= 0) {
+            break;
+        }
+    }
+    ::close(sockfd);
+}
+
+static double percentile(const std::vector<double> &sorted, double p) {
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1));
+    return sorted[index];
+}
+
+// ./bench [budget] [bulkClients] [pings] [port]
+int main(int argc, char **argv) {
+    size_t budget = argc > 1 ? atoi(argv[1]) : 16384;
+    int bulkClients = argc > 2 ? atoi(argv[2]) : 4;
+    int pings = argc > 3 ? atoi(argv[3]) : 2000;
+    uint16_t port = argc > 4 ? atoi(argv[4]) : 9999;
+
+    EventLoopThread loopThread;
+    TcpServer server(loopThread.startLoop(), InetAddress(port), "FairnessBench");
+    server.setReadBudget(budget);
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback(onMessage);
+    server.start();
+
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> bulks;
+    for(int i = 0; i < bulkClients; i++) {
+        bulks.emplace_back(runBulk, port, &stop);
+    }
+    ::usleep(200 * 1000);
+
+    int sockfd = connectTo(port);
+    if(sockfd < 0) {
+        std::cerr << "connect failed" << std::endl;
+        return 1;
+    }
+    std::vector<double> latencies;
+    for(int i = 0; i < pings; i++) {
+        auto start = std::chrono::steady_clock::now();
+        char reply;
+        if(::send(sockfd, "p\n", 2, MSG_NOSIGNAL) != 2 || ::recv(sockfd, &reply, 1, 0) != 1) {
+            std::cerr << "ping failed" << std::endl;
+            break;
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        latencies.push_back(elapsed.count());
+    }
+    ::close(sockfd);
+
+    TrafficStats stats = server.trafficStats();
+    stop = true;
+    for(std::thread &t : bulks) {
+        t.join();
+    }
+    if(latencies.empty()) {
+        return 1;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << "budget " << budget << ", " << bulkClients << " bulk clients, " << latencies.size() << " pings" << std::endl;
+    std::cout << "ping p50 " << percentile(latencies, 0.5) << "us, p99 " << percentile(latencies, 0.99)
+              << "us, max " << latencies.back() << "us" << std::endl;
+    std::cout << "bulk " << stats.bytesIn / (1024 * 1024) << "MB in " << stats.readCalls << " reads, "
+              << stats.readBudgetHits << " budget hits" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "mymuduo/TcpServer.h"
+#include "mymuduo/HotRestart.h"
+#include "mymuduo/Logger.h"
+
+// #include "TcpServer.h"
+// #include "HotRestart.h"
+// #include "Logger.h"
+
+#include <iostream>
+#include <string>
+#include <memory>
+#include <vector>
+#include <unistd.h>
+
+using namespace mymuduo;
+
+/**
+ * 可以热重启的 echo 服务器
+ * 升级时直接启动新的二进制：新进程从旧进程拿到监听 socket 后开始 accept，
+ * 旧进程停止监听、把已有连接上的数据发送完以后退出，整个过程中端口一直可以连接
+ *
+ * ./server port [unixPath]
+*/
+int main(int argc, char **argv) {
+    mymuduo::initLog("hotrestart_log");
+
+    uint16_t port = argc > 1 ? atoi(argv[1]) : 9999;
+    std::string path = argc > 2 ? argv[2] : "/tmp/mymuduo_hotrestart.sock";
+
+    EventLoop loop;
+
+    // 先尝试从旧进程接管监听 socket，没有旧进程时自己监听
+    HotRestartClient takeover(path);
+    std::vector<int> fds;
+    std::unique_ptr<TcpServer> server;
+    if(takeover.fetch(&fds) && !fds.empty()) {
+        std::cout << "pid " << ::getpid() << " took over listen fd " << fds[0] << std::endl;
+        for(size_t i = 1; i < fds.size(); i++) {
+            ::close(fds[i]);
+        }
+        server.reset(new TcpServer(&loop, fds[0], "HotRestartEcho"));
+    } else {
+        std::cout << "pid " << ::getpid() << " listening on " << port << std::endl;
+        server.reset(new TcpServer(&loop, InetAddress(port), "HotRestartEcho"));
+    }
+
+    server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+    });
+    server->setConnectionCallback([](const TcpConnectionPtr &) {});
+    server->setThreadNum(2);
+    server->start();
+
+    // 已经开始 accept，通知旧进程退出
+    loop.queueInLoop([&takeover]() { takeover.ready(); });
+
+    // 等待下一次升级
+    HotRestartServer restart(&loop, path);
+    restart.setFds({ server->listenFd() });
+    restart.setTakeoverCallback([&]() {
+        std::cout << "pid " << ::getpid() << " taken over, draining" << std::endl;
+        server->shutdownGracefully(10.0, nullptr, [&](const TcpServer::ShutdownStats &stats) {
+            std::cout << "pid " << ::getpid() << " drained " << stats.drained
+                      << ", killed " << stats.killed << std::endl;
+            loop.quit();
+        });
+    });
+    restart.start();
+
+    loop.loop();
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include "mymuduo/TcpServer.h"
+#include "mymuduo/EventLoopThread.h"
+#include "mymuduo/CurrentThread.h"
+#include "mymuduo/Logger.h"
+
+// #include "TcpServer.h"
+// #include "EventLoopThread.h"
+// #include "CurrentThread.h"
+// #include "Logger.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace mymuduo;
+
+/**
+ * 流水线请求测试：客户端一次发送 pipeline 个以 '\n' 结尾的请求，服务端对每个请求调用 3 次 send（header / body / trailer）
+ * 统计 subLoop 线程的 write 类系统调用次数（/proc/self/task/<tid>/io 中的 syscw）平均到每个响应
+ *      plain    ：不开启写合并，每次 send 都会尝试 write
+ *      coalesce ：开启写合并，每轮事件循环每个连接只 writev 一次
+ *      close    ：开启写合并，每个连接只发一个请求，服务端 send 完响应后立即 shutdown（HTTP/1.0 式的短连接），
+ *                 客户端读到 EOF 时必须已经收到完整的响应，统计不完整的响应数
+ *      nodelay  ：不开启写合并，连接使用 SocketOptions::lowLatency()（关闭 Nagle）
+ * plain 模式下第二次小包 write 会被 Nagle 算法挡住，等客户端的延迟 ACK，吞吐会低很多
+*/
+static long writeSyscalls(pid_t tid) {
+    std::ifstream io("/proc/self/task/" + std::to_string(tid) + "/io");
+    std::string key;
+    long value = 0;
+    while(io >> key >> value) {
+        if(key == "syscw:") {
+            return value;
+        }
+    }
+    return -1;
+}
+
+static void runClient(uint16_t port, int requests, int pipeline, size_t responseLen) {
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(port, "127.0.0.1");
+    while(::connect(sockfd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+        ::usleep(10 * 1000);
+    }
+
+    std::string batch;
+    for(int i = 0; i < pipeline; i++) {
+        batch += "GET /\n";
+    }
+    char buf[65536];
+    for(int sent = 0; sent < requests; sent += pipeline) {
+        ::write(sockfd, batch.data(), batch.size());
+        size_t expected = responseLen * pipeline;
+        while(expected > 0) {
+            ssize_t n = ::read(sockfd, buf, std::min(sizeof(buf), expected));
+            if(n <= 0) {
+                ::close(sockfd);
+                return ;
+            }
+            expected -= n;
+        }
+    }
+    ::close(sockfd);
+}
+
+// 每个请求一个连接，读到 EOF 为止，返回收到的响应不完整的连接数
+static int runCloseClient(uint16_t port, int requests, size_t responseLen) {
+    InetAddress addr(port, "127.0.0.1");
+    int broken = 0;
+    char buf[65536];
+    for(int i = 0; i < requests; i++) {
+        int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if(::connect(sockfd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+            ::close(sockfd);
+            ::usleep(1000);
+            --i;
+            continue;
+        }
+        ::write(sockfd, "GET /\n", 6);
+        size_t received = 0;
+        ssize_t n;
+        while((n = ::read(sockfd, buf, sizeof(buf))) > 0) {
+            received += n;
+        }
+        if(received != responseLen) {
+            ++broken;
+        }
+        ::close(sockfd);
+    }
+    return broken;
+}
+
+// ./bench [plain|coalesce|nodelay|close] [requests] [pipeline] [port]
+int main(int argc, char **argv) {
+    std::string mode = argc > 1 ? argv[1] : "coalesce";
+    int requests = argc > 2 ? atoi(argv[2]) : 10000;
+    int pipeline = argc > 3 ? atoi(argv[3]) : 16;
+    uint16_t port = argc > 4 ? atoi(argv[4]) : 9999;
+
+    const std::string header = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\n";
+    const std::string body = "hello";
+    const std::string trailer = "\r\n";
+    const size_t responseLen = header.size() + body.size() + trailer.size();
+
+    EventLoopThread loopThread;
+    TcpServer server(loopThread.startLoop(), InetAddress(port), "PipelineBench");
+    server.setThreadNum(1);
+    if(mode == "nodelay") {
+        server.setSocketOptions(SocketOptions::lowLatency());
+    }
+
+    std::atomic<pid_t> ioTid(0);
+    server.setThreadInitCallback([&ioTid](EventLoop *) { ioTid = CurrentThread::tid(); });
+    server.setConnectionCallback([&mode](const TcpConnectionPtr &conn) {
+        if(conn->connected() && mode != "plain" && mode != "nodelay") {
+            conn->setWriteCoalescing(true);
+        }
+    });
+    server.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        const char *eol = nullptr;
+        while((eol = buf->findEOL()) != nullptr) {
+            buf->retrieveUntil(eol + 1);
+            conn->send(header.data(), header.size());
+            conn->send(body.data(), body.size());
+            conn->send(trailer.data(), trailer.size());
+            if(mode == "close") {
+                conn->shutdown();
+            }
+        }
+    });
+    server.start();
+    while(ioTid == 0) {
+        ::usleep(1000);
+    }
+
+    if(mode == "close") {
+        int broken = runCloseClient(port, requests, responseLen);
+        std::cout << mode << ": " << requests << " connections, " << broken << " incomplete responses" << std::endl;
+        return broken == 0 ? 0 : 1;
+    }
+
+    long before = writeSyscalls(ioTid);
+    auto start = std::chrono::steady_clock::now();
+    runClient(port, requests, pipeline, responseLen);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    long syscalls = writeSyscalls(ioTid) - before;
+
+    std::cout << mode << ": " << requests << " responses, pipeline " << pipeline << ", "
+              << static_cast<double>(syscalls) / requests << " write syscalls/response, "
+              << requests / elapsed.count() << " responses/s" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "mymuduo/TcpServer.h"
+#include "mymuduo/Prefork.h"
+#include "mymuduo/Logger.h"
+
+// #include "TcpServer.h"
+// #include "Prefork.h"
+// #include "Logger.h"
+
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace mymuduo;
+
+/**
+ * prefork 多进程 echo 服务器：master fork 出 workers 个进程，每个进程用 SO_REUSEPORT 监听同一个端口
+ * master 每秒打印所有 worker 的流量统计；kill -9 某个 worker 后 master 会重新 fork 一个，Ctrl-C 优雅退出
+ *
+ * ./server port [workers] [threadsPerWorker]
+*/
+int main(int argc, char **argv) {
+    uint16_t port = argc > 1 ? atoi(argv[1]) : 9999;
+    int workers = argc > 2 ? atoi(argv[2]) : 4;
+    int threads = argc > 3 ? atoi(argv[3]) : 0;
+
+    PreforkServer master(workers, [port, threads](PreforkWorker *worker) {
+        // 日志线程需要在 worker 中启动
+        mymuduo::initLog(("prefork_log_" + std::to_string(worker->index())).c_str());
+
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(port), "PreforkEcho", TcpServer::kReusePort);
+        server.setConnectionCallback([](const TcpConnectionPtr &) {});
+        server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            conn->send(buf);
+        });
+        server.setThreadNum(threads);
+        server.start();
+        worker->attach(&loop, &server);
+        loop.loop();
+    });
+
+    master.setStatsCallback([&master](const TrafficStats &total, const std::vector<TrafficStats> &perWorker) {
+        std::cout << "connections " << total.activeConnections << " active / " << total.totalConnections
+                  << " total, bytes in " << total.bytesIn << ", out " << total.bytesOut
+                  << ", restarts " << master.restarts() << ", per worker :";
+        for(const TrafficStats &stats : perWorker) {
+            std::cout << " " << stats.totalConnections;
+        }
+        std::cout << std::endl;
+    });
+
+    std::cout << "master pid " << ::getpid() << ", " << workers << " workers on port " << port << std::endl;
+    return master.run();
+}
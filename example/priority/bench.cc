@@ -0,0 +1,155 @@
+#include "mymuduo/TcpServer.h"
+#include "mymuduo/EventLoopThread.h"
+
+// #include "TcpServer.h"
+// #include "EventLoopThread.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace mymuduo;
+
+/**
+ * 优先级测试：数据端口和管理端口的 TcpServer 共用一个 loop，bulkClients 个连接不停地向数据端口发送大块数据，
+ * 服务端对每个字节做一点计算（模拟协议解析），让 loop 处于饱和状态
+ *      - 管理连接每次发送 "p\n"，服务端回复 "\n"，统计往返延迟（健康检查）
+ *      - 另一个线程向 loop queueInLoop 一个空任务，统计从投递到执行的延迟（控制类任务）
+ *
+ * 分别用 high（管理连接和任务使用 kHighPriority）和 normal 运行，对比两者的 p50 / p99
+*/
+static uint32_t g_sink = 0;
+
+static void onBulkMessage(const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+    const char *data = buf->peek();
+    const size_t len = buf->readableBytes();
+    uint32_t hash = g_sink;
+    for(size_t i = 0; i < len; i++) {
+        for(int round = 0; round < 8; round++) {
+            hash = hash * 31 + static_cast<unsigned char>(data[i]);
+        }
+    }
+    g_sink = hash;
+    buf->retrieveAll();
+}
+
+static void onAdminMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+    size_t replies = std::count(buf->peek(), buf->peek() + buf->readableBytes(), '\n');
+    buf->retrieveAll();
+    if(replies > 0) {
+        conn->send(std::string(replies, '\n'));
+    }
+}
+
+static int connectTo(uint16_t port) {
+    InetAddress addr(port, "127.0.0.1");
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if(::connect(sockfd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+        ::close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+static void runBulk(uint16_t port, const std::atomic<bool> *stop) {
+    int sockfd = connectTo(port);
+    if(sockfd < 0) {
+        return ;
+    }
+    std::string chunk(256 * 1024, 'x');
+    while(!*stop) {
+        if(::send(sockfd, chunk.data(), chunk.size(), MSG_NOSIGNAL) <= 0) {
+            break;
+        }
+    }
+    ::close(sockfd);
+}
+
+static void report(const char *what, std::vector<double> &latencies) {
+    if(latencies.empty()) {
+        return ;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << what << " p50 " << latencies[latencies.size() / 2]
+              << "us, p99 " << latencies[(latencies.size() - 1) * 99 / 100]
+              << "us, max " << latencies.back() << "us" << std::endl;
+}
+
+// ./bench [high|normal] [bulkClients] [samples] [port]
+int main(int argc, char **argv) {
+    bool high = argc > 1 ? ::strcmp(argv[1], "normal") != 0 : true;
+    int bulkClients = argc > 2 ? atoi(argv[2]) : 4;
+    int samples = argc > 3 ? atoi(argv[3]) : 1000;
+    uint16_t port = argc > 4 ? atoi(argv[4]) : 9999;
+    const EventPriority priority = high ? kHighPriority : kNormalPriority;
+
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+
+    TcpServer dataServer(loop, InetAddress(port), "PriorityData");
+    dataServer.setConnectionCallback([](const TcpConnectionPtr &) {});
+    dataServer.setMessageCallback(onBulkMessage);
+    dataServer.start();
+
+    TcpServer adminServer(loop, InetAddress(port + 1), "PriorityAdmin");
+    adminServer.setConnectionPriority(priority);
+    adminServer.setConnectionCallback([](const TcpConnectionPtr &) {});
+    adminServer.setMessageCallback(onAdminMessage);
+    adminServer.start();
+
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> bulks;
+    for(int i = 0; i < bulkClients; i++) {
+        bulks.emplace_back(runBulk, port, &stop);
+    }
+    ::usleep(200 * 1000);
+
+    int sockfd = connectTo(port + 1);
+    if(sockfd < 0) {
+        std::cerr << "connect failed" << std::endl;
+        return 1;
+    }
+    std::vector<double> pings;
+    for(int i = 0; i < samples; i++) {
+        auto start = std::chrono::steady_clock::now();
+        char reply;
+        if(::send(sockfd, "p\n", 2, MSG_NOSIGNAL) != 2 || ::recv(sockfd, &reply, 1, 0) != 1) {
+            std::cerr << "ping failed" << std::endl;
+            break;
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        pings.push_back(elapsed.count());
+    }
+    ::close(sockfd);
+
+    std::vector<double> tasks;
+    for(int i = 0; i < samples; i++) {
+        std::promise<std::chrono::steady_clock::time_point> ran;
+        std::future<std::chrono::steady_clock::time_point> done = ran.get_future();
+        auto start = std::chrono::steady_clock::now();
+        loop->queueInLoop([&ran]() { ran.set_value(std::chrono::steady_clock::now()); }, priority);
+        std::chrono::duration<double, std::micro> elapsed = done.get() - start;
+        tasks.push_back(elapsed.count());
+    }
+
+    stop = true;
+    for(std::thread &t : bulks) {
+        t.join();
+    }
+
+    std::cout << (high ? "high" : "normal") << " priority, " << bulkClients << " bulk clients, "
+              << samples << " samples" << std::endl;
+    report("admin ping", pings);
+    report("queued task", tasks);
+
+    return 0;
+}
@@ -1,11 +1,14 @@
 #include "codec.h"
 #include "mymuduo/Logger.h"
+#include "mymuduo/BufferWriter.h"
+#include "mymuduo/ByteOrder.h"
 
 void ProtobufCodec::fillEmptyBuffer(Buffer *buf, const google::protobuf::Message &message) {
     const std::string &typeName = message.GetTypeName();
     int32_t nameLen = (int32_t)(typeName.size() + 1);
-    buf->appendInt32(nameLen);
-    buf->append(typeName.c_str(), nameLen);
+    BufferWriter writer(buf);
+    writer.writeBE(nameLen);
+    writer.writeBytes(typeName.c_str(), nameLen);
 
     #if GOOGLE_PROTOBUF_VERSION > 3009002
         int byte_size = google::protobuf::internal::ToIntSize(message.ByteSizeLong());
@@ -66,18 +69,11 @@ google::protobuf::Message *ProtobufCodec::createMessage(const std::string &typeN
     return message;
 }
 
-int toHost32(const char *buf) {
-    int32_t nw32 = 0;
-    ::memcpy(&nw32, buf, sizeof(nw32));
-    int32_t host32 = ::ntohl(nw32);
-    return host32;
-}
-
 MessagePtr ProtobufCodec::parse(const char *buf, int len, ErrorCode *error) {
     MessagePtr message;
 
     // get message type name
-    int32_t nameLen = toHost32(buf);
+    int32_t nameLen = endian::loadBE<int32_t>(buf);
     if(nameLen >= 2 && nameLen <= len - kHeaderLen) {
         std::string typeName(buf + kHeaderLen, buf + kHeaderLen + nameLen - 1);
         message.reset(createMessage(typeName));
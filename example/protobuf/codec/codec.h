@@ -45,8 +45,7 @@ public:
         
         Buffer buf;
         fillEmptyBuffer(&buf, message);
-        std::string msg = buf.retrieveAllAsString();
-        conn->send(msg);
+        conn->send(buf.peek(), buf.readableBytes());
     }
 
     static const std::string &errorCodeToString(ErrorCode errorCode);
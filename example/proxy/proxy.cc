@@ -0,0 +1,136 @@
+#include "mymuduo/TcpServer.h"
+#include "mymuduo/TcpClient.h"
+#include "mymuduo/Logger.h"
+
+// #include "TcpServer.h"
+// #include "TcpClient.h"
+// #include "Logger.h"
+
+#include <iostream>
+#include <string>
+#include <memory>
+#include <functional>
+
+using namespace mymuduo;
+using namespace std::placeholders;
+
+/**
+ * 一条隧道：客户端连接 serverConn_ <---> 到后端的连接 client_
+ * 后端连接和客户端连接使用同一个 subLoop，连上以后通过 TcpConnection::startRelay 用 splice 互相转发
+ * Tunnel 保存在客户端连接的上下文中（TcpConnection::setContext），由客户端连接决定它的生命期
+*/
+class Tunnel;
+using TunnelPtr = std::shared_ptr<Tunnel>;
+
+class Tunnel : public std::enable_shared_from_this<Tunnel>, noncopyable {
+public:
+    Tunnel(EventLoop *loop, const InetAddress &backendAddr, const TcpConnectionPtr &serverConn)
+        : client_(loop, backendAddr, serverConn->name()),
+          serverConn_(serverConn)
+    {
+        LOG_INFO << "Tunnel " << serverConn->peerAddress().toIpPort()
+                 << " <-> " << backendAddr.toIpPort();
+    }
+
+    void setup() {
+        // 只持有 weak_ptr，Tunnel 的生命期由客户端连接的上下文决定
+        std::weak_ptr<Tunnel> weakTunnel(shared_from_this());
+        client_.setConnectionCallback([weakTunnel](const TcpConnectionPtr &backendConn) {
+            TunnelPtr tunnel = weakTunnel.lock();
+            if(tunnel) {
+                tunnel->onClientConnection(backendConn);
+            }
+        });
+        // 后端连上之前暂停读取客户端，已经读到的数据留在 inputBuffer_ 中，startRelay 时会先转发出去
+        client_.setMessageCallback([](const TcpConnectionPtr &, Buffer *, Timestamp) {});
+    }
+
+    void connect() {
+        client_.connect();
+    }
+
+    void disconnect() {
+        client_.disconnect();
+    }
+
+private:
+    void onClientConnection(const TcpConnectionPtr &backendConn) {
+        if(backendConn->connected()) {
+            LOG_INFO << "backend UP : " << backendConn->peerAddress().toIpPort();
+            if(serverConn_->connected()) {
+                serverConn_->startRelay(backendConn);
+                serverConn_->startRead();
+            } else {
+                backendConn->shutdown();
+            }
+        } else {
+            LOG_INFO << "backend DOWN : " << backendConn->peerAddress().toIpPort();
+            serverConn_->shutdown();
+        }
+    }
+
+    TcpClient client_;
+    TcpConnectionPtr serverConn_;
+};
+
+class ProxyServer {
+public:
+    ProxyServer(EventLoop *loop, const InetAddress &listenAddr, const InetAddress &backendAddr)
+        : server_(loop, listenAddr, "SpliceProxy"),
+          backendAddr_(backendAddr)
+    {
+        server_.setConnectionCallback(std::bind(&ProxyServer::onConnection, this, _1));
+        server_.setMessageCallback([](const TcpConnectionPtr &, Buffer *, Timestamp) {});
+        server_.setThreadNum(2);
+    }
+
+    void start() {
+        server_.start();
+    }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn) {
+        if(conn->connected()) {
+            // 后端连上之前不读取客户端的数据，避免 inputBuffer_ 无限增长
+            conn->stopRead();
+            TunnelPtr tunnel(new Tunnel(conn->getLoop(), backendAddr_, conn));
+            tunnel->setup();
+            tunnel->connect();
+            // Tunnel 挂在连接的上下文上，不需要再维护一个加锁的 map
+            conn->setContext(tunnel);
+        } else {
+            Tunnel *tunnel = conn->getContext<Tunnel>();
+            if(tunnel) {
+                tunnel->disconnect();
+                // Tunnel 持有 conn，这里清除上下文打破循环引用
+                conn->clearContext();
+            }
+        }
+    }
+
+    TcpServer server_;
+    InetAddress backendAddr_;
+};
+
+// ./proxy listenPort backendIp backendPort
+// 例如先启动 example/echoServer 的 ./server 9999，再启动 ./proxy 8888 127.0.0.1 9999，然后连接 8888 端口
+int main(int argc, char **argv) {
+    mymuduo::initLog("proxy_log");
+
+    uint16_t listenPort = 8888;
+    std::string backendIp = "127.0.0.1";
+    uint16_t backendPort = 9999;
+    if(argc > 3) {
+        listenPort = atoi(argv[1]);
+        backendIp = argv[2];
+        backendPort = atoi(argv[3]);
+    }
+    std::cout << "proxy " << listenPort << " -> " << backendIp << ":" << backendPort << std::endl;
+
+    EventLoop loop;
+    ProxyServer server(&loop, InetAddress(listenPort), InetAddress(backendPort, backendIp));
+    server.start();
+    loop.loop();
+
+    return 0;
+}
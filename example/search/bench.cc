@@ -0,0 +1,72 @@
+#include "mymuduo/Buffer.h"
+
+// #include "Buffer.h"
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <string.h>
+
+using namespace mymuduo;
+
+/**
+ * Buffer::findByte / findCRLF / findSequence 与 memchr / std::search 的对比
+ * 每一轮在 size 字节的随机文本中查找位于末尾的分隔符
+*/
+static double measure(const char *name, size_t bytesPerRound, int rounds, const std::function<const char *()> &fn) {
+    const char *volatile sink = nullptr;
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; i++) {
+        sink = fn();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double gbps = bytesPerRound * (double)rounds / elapsed.count() / 1e9;
+    std::cout << "  " << name << ": " << gbps << " GB/s" << (sink ? "" : " (not found)") << std::endl;
+    return gbps;
+}
+
+// ./bench [size] [rounds]
+int main(int argc, char **argv) {
+    size_t size = argc > 1 ? atoi(argv[1]) : 64 * 1024;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20000;
+
+    // 只包含可打印字符和孤立的 '\r'，分隔符只出现在末尾
+    std::string text(size, 'a');
+    for(size_t i = 0; i < size; i++) {
+        text[i] = (i % 97 == 0) ? '\r' : static_cast<char>('a' + i * 7 % 26);
+    }
+    const std::string boundary = "--boundary--";
+    std::copy(boundary.begin(), boundary.end(), text.end() - boundary.size() - 2);
+    text[size - 2] = '\r';
+    text[size - 1] = '\n';
+
+    Buffer buf;
+    buf.append(text.data(), text.size());
+    const char *begin = buf.peek();
+    const char *end = begin + buf.readableBytes();
+
+    std::cout << "search impl = " << search::implName() << ", size = " << size << std::endl;
+
+    std::cout << "find '\\n'" << std::endl;
+    measure("Buffer::findEOL", size, rounds, [&]() { return buf.findEOL(); });
+    measure("memchr", size, rounds, [&]() { return static_cast<const char *>(::memchr(begin, '\n', end - begin)); });
+
+    std::cout << "find \"\\r\\n\"" << std::endl;
+    measure("Buffer::findCRLF", size, rounds, [&]() { return buf.findCRLF(); });
+    measure("std::search", size, rounds, [&]() {
+        const char *crlf = "\r\n";
+        const char *p = std::search(begin, end, crlf, crlf + 2);
+        return p == end ? nullptr : p;
+    });
+
+    std::cout << "find \"" << boundary << "\"" << std::endl;
+    measure("Buffer::findSequence", size, rounds, [&]() { return buf.findSequence(boundary.data(), boundary.size()); });
+    measure("std::search", size, rounds, [&]() {
+        const char *p = std::search(begin, end, boundary.begin(), boundary.end());
+        return p == end ? nullptr : p;
+    });
+
+    return 0;
+}
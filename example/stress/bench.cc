@@ -0,0 +1,135 @@
+#include "mymuduo/TcpServer.h"
+#include "mymuduo/EventLoopThread.h"
+#include "mymuduo/Logger.h"
+#include "mymuduo/ByteOrder.h"
+
+// #include "TcpServer.h"
+// #include "EventLoopThread.h"
+// #include "Logger.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace mymuduo;
+
+/**
+ * 多个生产者线程同时向同一个连接 send（跨线程，数据移动进投递的任务）
+ * 每条消息：| len(4) | producer(4) | seq(4) | payload |，payload 的每个字节都是 (producer + seq) & 0xff
+ * 接收端校验每个生产者的消息按顺序到达且内容没有被改写
+*/
+static const size_t kHeaderLen = 12;
+
+static std::string makeMessage(uint32_t producer, uint32_t seq, size_t payloadLen) {
+    std::string msg(kHeaderLen + payloadLen, static_cast<char>((producer + seq) & 0xff));
+    endian::storeBE(&msg[0], static_cast<uint32_t>(msg.size()));
+    endian::storeBE(&msg[4], producer);
+    endian::storeBE(&msg[8], seq);
+    return msg;
+}
+
+static bool receiveAndVerify(uint16_t port, int producers, int messages, size_t payloadLen) {
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(port, "127.0.0.1");
+    while(::connect(sockfd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+        ::usleep(10 * 1000);
+    }
+
+    std::vector<uint32_t> nextSeq(producers, 0);
+    std::string pending;
+    long total = static_cast<long>(producers) * messages;
+    long received = 0;
+    bool ok = true;
+    char buf[65536];
+    while(received < total && ok) {
+        ssize_t n = ::read(sockfd, buf, sizeof(buf));
+        if(n <= 0) {
+            break;
+        }
+        pending.append(buf, n);
+        size_t pos = 0;
+        while(pending.size() - pos >= kHeaderLen) {
+            uint32_t len = endian::loadBE<uint32_t>(&pending[pos]);
+            if(pending.size() - pos < len) {
+                break;
+            }
+            uint32_t producer = endian::loadBE<uint32_t>(&pending[pos + 4]);
+            uint32_t seq = endian::loadBE<uint32_t>(&pending[pos + 8]);
+            if(len != kHeaderLen + payloadLen || producer >= static_cast<uint32_t>(producers) || seq != nextSeq[producer]) {
+                ok = false;
+                break;
+            }
+            char expected = static_cast<char>((producer + seq) & 0xff);
+            if(pending.find_first_not_of(expected, pos + kHeaderLen) < pos + len) {
+                ok = false;
+                break;
+            }
+            nextSeq[producer]++;
+            received++;
+            pos += len;
+        }
+        pending.erase(0, pos);
+    }
+    ::close(sockfd);
+    return ok && received == total;
+}
+
+// ./bench [producers] [messages per producer] [payload] [port]
+int main(int argc, char **argv) {
+    int producers = argc > 1 ? atoi(argv[1]) : 8;
+    int messages = argc > 2 ? atoi(argv[2]) : 100000;
+    size_t payloadLen = argc > 3 ? atoi(argv[3]) : 100;
+    uint16_t port = argc > 4 ? atoi(argv[4]) : 9999;
+
+    // baseLoop 运行在单独的线程中，主线程负责启动生产者线程
+    EventLoopThread loopThread;
+    TcpServer server(loopThread.startLoop(), InetAddress(port), "SendStress");
+    server.setThreadNum(1);
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    TcpConnectionPtr connection;
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        std::unique_lock<std::mutex> lock(mutex);
+        connection = conn->connected() ? conn : TcpConnectionPtr();
+        cond.notify_all();
+    });
+    server.start();
+
+    bool ok = false;
+    std::thread receiver([&]() { ok = receiveAndVerify(port, producers, messages, payloadLen); });
+
+    TcpConnectionPtr conn;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&connection]() { return connection != nullptr; });
+        conn = connection;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for(int p = 0; p < producers; p++) {
+        threads.emplace_back([conn, p, messages, payloadLen]() {
+            for(int i = 0; i < messages; i++) {
+                conn->send(makeMessage(p, i, payloadLen));
+            }
+        });
+    }
+    for(std::thread &t : threads) {
+        t.join();
+    }
+    receiver.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    long total = static_cast<long>(producers) * messages;
+    std::cout << producers << " producers, " << total << " messages, " << (ok ? "verified" : "CORRUPTED")
+              << ", " << total / elapsed.count() << " msg/s" << std::endl;
+
+    return ok ? 0 : 1;
+}
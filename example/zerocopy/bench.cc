@@ -0,0 +1,129 @@
+#include "mymuduo/TcpServer.h"
+#include "mymuduo/Logger.h"
+
+// #include "TcpServer.h"
+// #include "Logger.h"
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <memory>
+#include <functional>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace mymuduo;
+using namespace std::placeholders;
+
+static double nowSeconds() {
+    struct timeval tv;
+    ::gettimeofday(&tv, nullptr);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double threadCpuSeconds() {
+    struct rusage usage;
+    ::getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+         + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+/**
+ * 回环地址上的发送端吞吐测试：sender 不断发送同一份 shared payload，receiver 线程读取并丢弃
+ * 统计发送线程（mainLoop）的 CPU 时间，对比拷贝发送和 MSG_ZEROCOPY 发送
+ * 注意：回环设备上内核会把 zerocopy 退化为延迟拷贝，真实网卡上的收益会更明显
+*/
+class Sender {
+public:
+    Sender(EventLoop *loop, const InetAddress &addr, bool zeroCopy, size_t payloadSize, size_t totalBytes)
+        : loop_(loop),
+          server_(loop, addr, "ZeroCopyBench"),
+          zeroCopy_(zeroCopy),
+          payload_(std::make_shared<const std::string>(payloadSize, 'z')),
+          totalBytes_(totalBytes),
+          sentBytes_(0),
+          startTime_(0),
+          startCpu_(0)
+    {
+        server_.setConnectionCallback(std::bind(&Sender::onConnection, this, _1));
+        server_.setWriteCompleteCallback(std::bind(&Sender::onWriteComplete, this, _1));
+    }
+
+    void start() {
+        server_.start();
+    }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn) {
+        if(conn->connected()) {
+            if(zeroCopy_ && !conn->enableZeroCopy()) {
+                std::cout << "SO_ZEROCOPY is not supported, fall back to copy" << std::endl;
+            }
+            startTime_ = nowSeconds();
+            startCpu_ = threadCpuSeconds();
+            sendNext(conn);
+        } else {
+            loop_->quit();
+        }
+    }
+
+    void onWriteComplete(const TcpConnectionPtr &conn) {
+        if(sentBytes_ < totalBytes_) {
+            sendNext(conn);
+        } else if(conn->connected()) {
+            double seconds = nowSeconds() - startTime_;
+            double cpu = threadCpuSeconds() - startCpu_;
+            std::cout << (zeroCopy_ ? "zerocopy" : "copy") << ": "
+                      << sentBytes_ / seconds / 1024 / 1024 << " MiB/s, sender cpu "
+                      << cpu << "s (" << cpu / seconds * 100 << "%), pending completions "
+                      << conn->zeroCopyPending() << std::endl;
+            conn->shutdown();
+        }
+    }
+
+    void sendNext(const TcpConnectionPtr &conn) {
+        sentBytes_ += payload_->size();
+        conn->send(payload_);
+    }
+
+    EventLoop *loop_;
+    TcpServer server_;
+    bool zeroCopy_;
+    std::shared_ptr<const std::string> payload_;
+    size_t totalBytes_;
+    size_t sentBytes_;
+    double startTime_;
+    double startCpu_;
+};
+
+static void receive(uint16_t port) {
+    int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress addr(port, "127.0.0.1");
+    while(::connect(sockfd, (sockaddr *)addr.getSockAddr(), sizeof(sockaddr_in)) < 0) {
+        ::usleep(10 * 1000);
+    }
+
+    std::unique_ptr<char[]> buf(new char[1024 * 1024]);
+    while(::read(sockfd, buf.get(), 1024 * 1024) > 0) {}
+    ::close(sockfd);
+}
+
+// ./bench [copy|zerocopy] [payloadKB] [totalMB] [port]
+int main(int argc, char **argv) {
+    bool zeroCopy = argc > 1 && std::string(argv[1]) == "zerocopy";
+    size_t payloadKB = argc > 2 ? atoi(argv[2]) : 256;
+    size_t totalMB = argc > 3 ? atoi(argv[3]) : 4096;
+    uint16_t port = argc > 4 ? atoi(argv[4]) : 9999;
+
+    EventLoop loop;
+    Sender sender(&loop, InetAddress(port), zeroCopy, payloadKB * 1024, totalMB * 1024 * 1024);
+    sender.start();
+
+    std::thread receiver(receive, port);
+    loop.loop();
+    receiver.join();
+
+    return 0;
+}